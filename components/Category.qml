@@ -168,7 +168,7 @@ Item {
             if (endIndex < 0 || endIndex >= count) endIndex = count - 1;
 
             for (var index = begIndex; index < endIndex + 1; index++) {
-                var o = model[index];
+                var o = model.get(index);
                 if (o && o.face == "") {
                     QQ.Client.getSimpleInfo(o.gid, o.uin);
                 }
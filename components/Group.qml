@@ -48,10 +48,8 @@ Item {
                     Connections {
                         target: QQ.Client
                         onGroupReady: {
-                            if (gid === modelData.id) {
-                                group.model = QQ.Client.getGroupMembers(gid);
+                            if (gid === modelData.id)
                                 group.loaded = true;
-                            }
                         }
                         onSessionMessageReceived: {
                             if (gid == modelData.id && group.state == "")
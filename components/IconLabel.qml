@@ -4,28 +4,14 @@ import Ubuntu.Components 0.1
 Flow {
     id: contentFlow
     width: parent.width
-    property string textContent
+    property var segments       // [{text: "hello"}, {face: 14}, ...] from the message model
+    property var textFont       // {bold, italic, underline} or undefined
 
-    Component.onCompleted: {
-        var pattern = /\[face\d{1,3}\]/;
-        var index;
-
-        while (textContent.length > 0) {
-            index = textContent.search(pattern);
-            if (index < 0) {
-                textComponent.createObject(contentFlow, {text: textContent});
-                textContent = "";
-            } else {
-                if (index > 0) {
-                    textComponent.createObject(contentFlow, {text: textContent.substring(0, index)});
-                    textContent = textContent.substring(index);
-                }
-                var end = textContent.indexOf("]");
-                var face = textContent.substring(1, end);
-                faceComponent.createObject(contentFlow, {source: getFace(face.substring(4))});
-
-                textContent = textContent.substring(end + 1);
-            }
+    Repeater {
+        model: contentFlow.segments
+        Loader {
+            property var segment: modelData
+            sourceComponent: segment.face !== undefined ? faceComponent : textComponent
         }
     }
 
@@ -33,14 +19,19 @@ Flow {
         id: faceComponent
         AnimatedImage {
             asynchronous: true
+            source: getFace(parent.segment.face)
         }
     }
     Component {
         id: textComponent
         Label {
-            property int maxWidth: parent.width
+            property int maxWidth: contentFlow.width
             wrapMode: Text.Wrap
-            width:Math.min(maxWidth, paintedWidth)
+            width: Math.min(maxWidth, paintedWidth)
+            text: parent.segment.text
+            font.bold: textFont ? textFont.bold : false
+            font.italic: textFont ? textFont.italic : false
+            font.underline: textFont ? textFont.underline : false
         }
     }
 }
@@ -7,18 +7,6 @@ MainView {
     objectName: "mainView"
     applicationName: "uqq"
 
-    Timer {
-        id: pollTimer
-        interval: 63000     // trigger every 63s: 60s(max waiting time) + 3s(delay time)
-        repeat: true
-        running: true
-        triggeredOnStart: true
-        onTriggered: {
-            //console.log("poll timer triggered");
-            QQ.Client.poll();
-        }
-    }
-
     Audio {
         id: newMsgAudio
         source: "../res/sound/classic/msg.wav"
@@ -35,7 +23,7 @@ MainView {
         onGroupMessageReceived: newMsgAudio.play();
         onSessionMessageReceived: newMsgAudio.play();
         onBuddyOnline: onlineAudio.play();
-        onPollReceived: pollTimer.restart();
+        onReady: QQ.Client.poll();   // the client keeps polling from now on
     }
 
     Tabs {
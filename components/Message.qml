@@ -11,23 +11,42 @@ Item {
 
     signal sendClicked(string content)
 
+    // delivery state of a sent message
+    function stateText(state) {
+        switch (state) {
+        case QQ.MessageHistory.QueuedState:
+        case QQ.MessageHistory.SendingState:
+            return "  ...";
+        case QQ.MessageHistory.FailedState:
+            return "  " + i18n.tr("发送失败");
+        default:
+            return "";
+        }
+    }
+
     onLoadMsgChanged: {
         if (loadMsg) {
-            loadMessages(modelData.messages());
+            modelData.messages.load();
+            modelData.readMessages();
+            msgView.positionViewAtEnd();
         }
     }
 
+    Component.onDestruction: {
+        if (loadMsg)
+            modelData.messages.release();
+    }
+
     Connections {
         target: modelData
         onMessageReceived: {
-            loadMessages(modelData.messages(true));
+            if (loadMsg) {
+                modelData.readMessages();
+                msgView.positionViewAtEnd();
+            }
         }
     }
 
-    ListModel {
-        id: msgModel
-    }
-
     Column {
         anchors.fill: parent
         spacing: units.gu(1)
@@ -44,7 +63,13 @@ Item {
                 clip: true
                 spacing: units.gu(2)
 
-                model: msgModel
+                model: loadMsg ? modelData.messages : null
+
+                // page older messages in from the history log
+                onAtYBeginningChanged: {
+                    if (atYBeginning && moving)
+                        modelData.messages.load();
+                }
 
                 delegate: Column {
                     anchors {
@@ -54,13 +79,14 @@ Item {
                     spacing: units.gu(0.5)
 
                     Label {
-                        text: name + "  " + time
-                        color: isSend ? "blue" : "green"
+                        text: name + "  " + Qt.formatDateTime(time, "yyyy-MM-dd hh:mm:ss") + stateText(model.state)
+                        color: type === -1 ? "blue" : "green"
                     }
 
                     IconLabel {
                         width: parent.width
-                        textContent: content
+                        segments: model.segments
+                        textFont: model.font
                     }
                 }
 
@@ -116,18 +142,4 @@ Item {
     function getFace(faceid) {
         return "../res/face/default/" + faceid + ".gif";
     }
-
-    function loadMessages(msgs) {
-        for (var i = 0; i < msgs.length; i++) {
-            msgModel.append(
-                        {
-                            "name": msgs[i].name,
-                            "time": Qt.formatDateTime(msgs[i].time, "yyyy-MM-dd hh:mm:ss"),
-                            "content": msgs[i].content,
-                            "isSend": msgs[i].type === -1 ? true : false
-                        }
-                        );
-        }
-        msgView.positionViewAtEnd()
-    }
 }
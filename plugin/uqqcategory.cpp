@@ -1,4 +1,5 @@
 #include "uqqcategory.h"
+#include <climits>
 
 UQQCategory::UQQCategory(QObject *parent) :
     QObject(parent)
@@ -12,6 +13,8 @@ UQQCategory::UQQCategory(QObject *parent) :
     m_groupReady = false;
     m_messageCount = 0;
     m_messageMask = MessageNotify;
+    m_history = Q_NULLPTR;
+    m_memberModel = Q_NULLPTR;
 }
 
 quint64 UQQCategory::account() const {
@@ -98,6 +101,8 @@ bool UQQCategory::groupReady() const {
 void UQQCategory::setGroupReady(bool groupReady) {
     if (m_groupReady != groupReady) {
         m_groupReady = groupReady;
+        if (m_groupReady && m_history)
+            resolveNames();
         emit groupReadyChanged();
     }
 }
@@ -116,38 +121,49 @@ QList<UQQMember *> UQQCategory::members() {
     return m_members.values();
 }
 
-UQQMember *UQQCategory::member(const QString &uin) {
+UQQMember *UQQCategory::member(UQQUin uin) {
     return m_members.value(uin);
 }
 
-bool sortLessThan(UQQMember *m1, UQQMember *m2) {
-    if (m1->status() == UQQMember::OfflineStatus)
-        return false;
-    if (m2->status() == UQQMember::OfflineStatus)
-        return true;
-
-    return m1->status() < m2->status();
+UQQMember *UQQCategory::member(const QString &uin) {
+    return m_members.value(uin.toULongLong());
 }
 
 QList<UQQMember *> UQQCategory::sortedMembers() {
-    QList<UQQMember *> members = m_members.values();
-    qSort(members.begin(), members.end(), sortLessThan);
-    return members;
+    return m_sortedMembers;
+}
+
+// created on first use, most groups are never opened
+QObject *UQQCategory::memberModel() {
+    if (!m_memberModel)
+        m_memberModel = new UQQMemberModel(m_sortedMembers, this);
+    return m_memberModel;
 }
 
 void UQQCategory::addMember(UQQMember *member) {
-    if (q_check_ptr(member)) {
-        m_members.insert(member->uin(), member);
-        emit totalChanged();
-    }
+    if (!q_check_ptr(member) || m_members.contains(member->uinKey())) return;
+
+    m_members.insert(member->uinKey(), member);
+    insertSorted(member);
+    connect(member, SIGNAL(statusChanged()), this, SLOT(onMemberChanged()));
+    connect(member, SIGNAL(nicknameChanged()), this, SLOT(onMemberChanged()));
+    connect(member, SIGNAL(marknameChanged()), this, SLOT(onMemberChanged()));
+    connect(member, SIGNAL(cardChanged()), this, SLOT(onMemberChanged()));
+
+    if (member->status() != UQQMember::OfflineStatus)
+        incOnline();
+    emit totalChanged();
 }
 
 int UQQCategory::removeMember(UQQMember *member) {
     if (!q_check_ptr(member)) return 0;
 
-    int count = m_members.remove(member->uin());
+    int count = m_members.remove(member->uinKey());
     if (count > 0) {
-        if (member->status() == UQQMember::OfflineStatus)
+        disconnect(member, 0, this, 0);
+        removeSorted(member);
+
+        if (member->status() != UQQMember::OfflineStatus)
             decOnline();
 
         emit totalChanged();
@@ -155,7 +171,111 @@ int UQQCategory::removeMember(UQQMember *member) {
     return count;
 }
 
-bool UQQCategory::hasMember(const QString &uin) {
+bool UQQCategory::SortKey::operator<(const SortKey &other) const {
+    if (rank != other.rank)
+        return rank < other.rank;
+    int cmp = name.compare(other.name);
+    if (cmp != 0)
+        return cmp < 0;
+    return uin < other.uin;
+}
+
+bool UQQCategory::SortKey::operator==(const SortKey &other) const {
+    return rank == other.rank && name == other.name && uin == other.uin;
+}
+
+UQQCategory::SortKey UQQCategory::sortKey(UQQMember *member) {
+    SortKey key;
+    key.rank = member->status() == UQQMember::OfflineStatus ? INT_MAX : member->status();
+    if (!member->card().isEmpty())
+        key.name = member->card();
+    else if (!member->markname().isEmpty())
+        key.name = member->markname();
+    else
+        key.name = member->nickname();
+    key.uin = member->uinKey();
+    return key;
+}
+
+int UQQCategory::lowerBound(const SortKey &key) const {
+    int low = 0;
+    int high = m_sortedMembers.size();
+
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (m_sortKeys.value(m_sortedMembers.at(mid)) < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+int UQQCategory::sortedIndex(UQQMember *member) const {
+    int index = lowerBound(m_sortKeys.value(member));
+    if (index < m_sortedMembers.size() && m_sortedMembers.at(index) == member)
+        return index;
+    return m_sortedMembers.indexOf(member); // the key went stale, should not happen
+}
+
+int UQQCategory::insertSorted(UQQMember *member) {
+    SortKey key = sortKey(member);
+    int index = lowerBound(key);
+
+    m_sortKeys.insert(member, key);
+    if (m_memberModel)
+        m_memberModel->beginInsertRows(QModelIndex(), index, index);
+    m_sortedMembers.insert(index, member);
+    if (m_memberModel)
+        m_memberModel->endInsertRows();
+    return index;
+}
+
+int UQQCategory::removeSorted(UQQMember *member) {
+    if (!m_sortKeys.contains(member)) return -1;
+
+    int index = sortedIndex(member);
+    if (index >= 0) {
+        if (m_memberModel)
+            m_memberModel->beginRemoveRows(QModelIndex(), index, index);
+        m_sortedMembers.removeAt(index);
+        if (m_memberModel)
+            m_memberModel->endRemoveRows();
+    }
+    m_sortKeys.remove(member);
+    return index;
+}
+
+/*
+ * Status and name changes move the member inside the sorted view,
+ * so sortedMembers() never has to sort the whole category.
+ */
+void UQQCategory::onMemberChanged() {
+    UQQMember *member = qobject_cast<UQQMember *>(sender());
+    if (!member || !m_sortKeys.contains(member)) return;
+
+    SortKey key = sortKey(member);
+    if (m_sortKeys.value(member) == key) return;
+
+    int from = sortedIndex(member);
+    if (from < 0) return;
+
+    // the member still sits at 'from' under its old key
+    int to = lowerBound(key);
+    if (to == from || to == from + 1) {
+        m_sortKeys.insert(member, key);
+        return;
+    }
+
+    if (m_memberModel)
+        m_memberModel->beginMoveRows(QModelIndex(), from, from, QModelIndex(), to);
+    m_sortedMembers.move(from, to > from ? to - 1 : to);
+    m_sortKeys.insert(member, key);
+    if (m_memberModel)
+        m_memberModel->endMoveRows();
+}
+
+bool UQQCategory::hasMember(UQQUin uin) {
     return m_members.contains(uin);
 }
 
@@ -168,28 +288,47 @@ void UQQCategory::decOnline() {
         setOnline(online() - 1);
 }
 
-void UQQCategory::addMessage(UQQMessage *message) {
-    if (!q_check_ptr(message)) return;
+UQQMessageHistory *UQQCategory::history() {
+    if (!m_history)
+        m_history = new UQQMessageHistory("group_" + QString::number(m_id), this);
+    return m_history;
+}
+
+QString UQQCategory::senderName(quint64 uin) {
+    UQQMember *member = this->member(uin);
+    if (!member) return QString();
+    return member->card().isEmpty() ? member->nickname() : member->card();
+}
+
+// messages may arrive before the group members are loaded
+void UQQCategory::resolveNames() {
+    for (int i = 0; i < m_history->rowCount(); i++) {
+        if (m_history->at(i).name().isEmpty()) {
+            QString name = senderName(m_history->at(i).src());
+            if (!name.isEmpty())
+                m_history->setName(i, name);
+        }
+    }
+}
 
-    m_messages.append(message);
+void UQQCategory::addMessage(const UQQMessage &message) {
+    if (message.name().isEmpty()) {
+        UQQMessage named(message);
+        named.setName(senderName(message.src()));
+        history()->append(named);
+    } else {
+        history()->append(message);
+    }
     setMessageCount(messageCount() + 1);
     emit messageReceived();
 }
 
-QList<QObject *> UQQCategory::messages(bool newMsg) {
-    UQQMember *member;
-    QList<QObject *> results;
-    const QList<UQQMessage *> &messages =
-            newMsg ? m_messages.mid(m_messages.count() - messageCount()) : m_messages;
-    foreach (UQQMessage *message, messages) {
-        member = this->member(message->src());
-        if (q_check_ptr(member))
-            message->setName(member->card() == "" ? member->nickname() : member->card());
-        results.append(message);
-    }
-    setMessageCount(0);
+QObject *UQQCategory::messages() {
+    return history();
+}
 
-    return results;
+void UQQCategory::readMessages() {
+    setMessageCount(0);
 }
 
 int UQQCategory::messageCount() const {
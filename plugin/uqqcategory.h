@@ -5,6 +5,8 @@
 #include <QList>
 #include "uqqmember.h"
 #include "uqqgroupinfo.h"
+#include "uqqmessagehistory.h"
+#include "uqqmembermodel.h"
 
 class UQQCategory : public QObject
 {
@@ -33,6 +35,7 @@ public:
     Q_PROPERTY(quint64 id READ id NOTIFY idChanged)
     Q_PROPERTY(UQQGroupInfo *groupInfo READ groupInfo NOTIFY groupInfoChanged)
     Q_PROPERTY(int messageCount READ messageCount NOTIFY messageCountChanged)
+    Q_PROPERTY(QObject *messages READ messages CONSTANT)
     Q_PROPERTY(bool groupReady READ groupReady NOTIFY groupReadyChanged)
     Q_PROPERTY(GroupMessageMask messageMask READ messageMask NOTIFY messageMaskChanged)
 
@@ -65,11 +68,13 @@ public:
 
     //void setMembers(const QList<UQQMember *> &members);
     QList<UQQMember *> members();
+    UQQMember *member(UQQUin uin);
     UQQMember *member(const QString &uin);
     QList<UQQMember *> sortedMembers();
+    QObject *memberModel();
     void addMember(UQQMember *member);
     int removeMember(UQQMember *member);
-    bool hasMember(const QString &uin);
+    bool hasMember(UQQUin uin);
 
     void incOnline();
     void decOnline();
@@ -77,8 +82,9 @@ public:
     int messageCount() const;
     void setMessageCount(int messageCount);
 
-    void addMessage(UQQMessage *message);
-    Q_INVOKABLE QList<QObject *> messages(bool newMsg = false);
+    void addMessage(const UQQMessage &message);
+    QObject *messages();
+    Q_INVOKABLE void readMessages();
 
 signals:
     void accountChanged();
@@ -96,7 +102,29 @@ signals:
 
 public slots:
 
+private slots:
+    void onMemberChanged();
+
 private:
+    // members are ordered by (status, display name), offline members last
+    struct SortKey {
+        int rank;
+        QString name;
+        UQQUin uin;
+
+        bool operator<(const SortKey &other) const;
+        bool operator==(const SortKey &other) const;
+    };
+
+    static SortKey sortKey(UQQMember *member);
+    int lowerBound(const SortKey &key) const;
+    int sortedIndex(UQQMember *member) const;
+    int insertSorted(UQQMember *member);
+    int removeSorted(UQQMember *member);
+    UQQMessageHistory *history();
+    QString senderName(quint64 uin);
+    void resolveNames();
+
     quint64 m_account;
     quint64 m_id;
     QString m_name;
@@ -108,9 +136,12 @@ private:
 
     GroupMessageMask m_messageMask;
 
-    QHash<QString, UQQMember*> m_members;
+    QHash<UQQUin, UQQMember*> m_members;
+    QList<UQQMember *> m_sortedMembers;
+    QHash<UQQMember *, SortKey> m_sortKeys;
+    UQQMemberModel *m_memberModel;
     UQQGroupInfo *m_groupInfo;
-    QList<UQQMessage *> m_messages;
+    UQQMessageHistory *m_history;
     int m_messageCount;
 };
 
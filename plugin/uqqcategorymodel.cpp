@@ -0,0 +1,29 @@
+#include "uqqcategorymodel.h"
+
+UQQCategoryModel::UQQCategoryModel(const QList<UQQCategory *> &categories, QObject *parent)
+    : QAbstractListModel(parent), m_categories(categories) {
+}
+
+int UQQCategoryModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) return 0;
+    return m_categories.size();
+}
+
+QVariant UQQCategoryModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= m_categories.size()) return QVariant();
+
+    if (role == CategoryRole)
+        return QVariant::fromValue(static_cast<QObject *>(m_categories.at(index.row())));
+    return QVariant();
+}
+
+QHash<int, QByteArray> UQQCategoryModel::roleNames() const {
+    QHash<int, QByteArray> roles;
+    roles[CategoryRole] = "modelData";
+    return roles;
+}
+
+QObject *UQQCategoryModel::get(int row) const {
+    if (row < 0 || row >= m_categories.size()) return Q_NULLPTR;
+    return m_categories.at(row);
+}
@@ -0,0 +1,37 @@
+#ifndef UQQCATEGORYMODEL_H
+#define UQQCATEGORYMODEL_H
+
+#include <QAbstractListModel>
+#include <QList>
+#include "uqqcategory.h"
+
+/*
+ * A live view over the contact categories or the group list.
+ *
+ * Like UQQMemberModel it reads the owner's list directly, UQQContact and
+ * UQQGroup bracket their changes with the model notifications.
+ */
+class UQQCategoryModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum CategoryRoles {
+        CategoryRole = Qt::UserRole + 1
+    };
+
+    explicit UQQCategoryModel(const QList<UQQCategory *> &categories, QObject *parent = 0);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QHash<int, QByteArray> roleNames() const;
+
+    Q_INVOKABLE QObject *get(int row) const;
+
+private:
+    friend class UQQContact;
+    friend class UQQGroup;
+
+    const QList<UQQCategory *> &m_categories;
+};
+
+#endif // UQQCATEGORYMODEL_H
@@ -1,5 +1,7 @@
 #include "uqqclient.h"
 #include "uqqmemberdetail.h"
+#include "uqqlog.h"
+#include <QSaveFile>
 
 //#define UQQ_TEST
 
@@ -10,19 +12,61 @@
 #define TEST(func)
 #endif
 
+// when the request was handed to the scheduler, UQQMetrics::elapsed()
+static const QNetworkRequest::Attribute SentAtAttribute =
+        QNetworkRequest::Attribute(QNetworkRequest::User + 1);
+
 UQQClient::UQQClient(QObject *parent)
     : QObject(parent) {
 
+    UQQLog::start();    // the writer takes lines from this thread only
     m_contact = Q_NULLPTR;
     m_group = Q_NULLPTR;
     m_manager = Q_NULLPTR;
+    m_scheduler = Q_NULLPTR;
+    m_startupStages = 0;
+    m_snapshotLoaded = false;
+    m_renewing = false;
+    setEndpoint(QString::fromLocal8Bit(qgetenv("UQQ_ENDPOINT")));
+
+    m_metricsTimer = new QTimer(this);
+    connect(m_metricsTimer, SIGNAL(timeout()), this, SLOT(dumpMetrics()));
+    setMetricsDump(QString::fromLocal8Bit(qgetenv("UQQ_METRICS_FILE")),
+                   qgetenv("UQQ_METRICS_INTERVAL").toInt());
+    m_nextMsgId = MinMsgId + m_random.bounded(MsgIdRange);
 
     initClient();
+    initHandlers();
+
+    m_snapshotTimer = new QTimer(this);
+    m_snapshotTimer->setSingleShot(true);
+    m_snapshotTimer->setInterval(3000);
+    connect(m_snapshotTimer, SIGNAL(timeout()), this, SLOT(saveSnapshot()));
+
+    m_demands = new UQQDemandQueue(this);
+    connect(m_demands, SIGNAL(demanded(int,quint64,QString)), this, SLOT(onDemand(int,quint64,QString)));
+
+    m_pollEngine = new UQQPollEngine(this);
+    connect(m_pollEngine, SIGNAL(pollRequested()), this, SLOT(sendPoll()));
+    connect(m_pollEngine, SIGNAL(offline()), this, SLOT(renewSession()));
+
+    m_sendQueue = new UQQSendQueue(this);
+    connect(m_sendQueue, SIGNAL(sendRequested(int,quint64,QString,QString,int)),
+            this, SLOT(sendQueued(int,quint64,QString,QString,int)));
+    connect(m_sendQueue, SIGNAL(stateChanged(int,quint64,QString,int,int)),
+            this, SLOT(onSendStateChanged(int,quint64,QString,int,int)));
 
 #ifndef UQQ_TEST
-    m_manager = new QNetworkAccessManager(this);
-    QObject::connect(m_manager, &QNetworkAccessManager::finished,
+    m_manager = new UQQNetworkManager(this);  // live, record or replay, see UQQ_TRANSPORT
+    m_scheduler = new UQQRequestScheduler(m_manager, this);
+    QObject::connect(m_scheduler, &UQQRequestScheduler::finished,
                     this, &UQQClient::onFinished);
+    QObject::connect(m_scheduler, &UQQRequestScheduler::sent,
+                    this, &UQQClient::onRequestSent);
+    QObject::connect(m_scheduler, &UQQRequestScheduler::coalesced,
+                    this, &UQQClient::onRequestCoalesced);
+    QObject::connect(m_scheduler, &UQQRequestScheduler::dropped,
+                    this, &UQQClient::onRequestDropped);
 #endif
 
     addLoginInfo("aid", QVariant("1003903"));  // appid
@@ -56,130 +100,229 @@ void UQQClient::initConfig() {
     addConfig("groupfacePath", groupFacePath);  // the group face images path
     QString facePath = userPath + "/faces";
     addConfig("facePath", facePath);    // the face images path
+    QString historyPath = userPath + "/history";
+    addConfig("historyPath", historyPath);  // the spilled message history path
+    addConfig("snapshotFile", userPath + "/snapshot.dat");  // contacts and groups of the last run
 
     QDir path;
-    if (!path.mkpath(facePath) || !path.mkpath(groupPath) || !path.mkpath(groupFacePath))
+    if (!path.mkpath(facePath) || !path.mkpath(groupPath) || !path.mkpath(groupFacePath) ||
+            !path.mkpath(historyPath))
         qCritical() << "Error: make path";
+    UQQMessageHistory::setPath(historyPath);
+    m_faceCache.setPath(facePath);
 }
 
 void UQQClient::onFinished(QNetworkReply *reply) {
     bool ok;
     Action action = (Action)reply->request().attribute(QNetworkRequest::User).toInt(&ok);
-    QVariantList p = reply->request().attribute(QNetworkRequest::UserMax).toList();
+    UQQRequestContext context = qvariant_cast<UQQRequestContext>(
+                reply->request().attribute(QNetworkRequest::UserMax));
+
+    qint64 latency = m_metrics.elapsed() - reply->request().attribute(SentAtAttribute).toLongLong();
 
     if (!ok || reply->error() != QNetworkReply::NoError) {
-        qWarning() << action << reply->error() << reply->errorString();
+        uqqWarning(Net) << action << reply->error() << reply->errorString();
+        m_metrics.failed(action, latency);
+        requestFailed(action, context);
+
+        // coalesced requests whose retry failed as well share the error
+        foreach (const QNetworkRequest &request, m_scheduler->takeWaiters(reply))
+            requestFailed(action, qvariant_cast<UQQRequestContext>(request.attribute(QNetworkRequest::UserMax)));
+        reply->deleteLater();
         return;
     }
 
     QByteArray data = reply->readAll();
+    qint64 start = m_metrics.elapsed();
+    handleReply(action, context, reply, data);
+
+    // requests coalesced into this one are answered with the same data
+    foreach (const QNetworkRequest &request, m_scheduler->takeWaiters(reply)) {
+        handleReply(action, qvariant_cast<UQQRequestContext>(request.attribute(QNetworkRequest::UserMax)),
+                    reply, data);
+    }
+    m_metrics.replied(action, latency, m_metrics.elapsed() - start);
+
+    reply->deleteLater();
+}
+
+/*
+ * Lookups have nothing to undo, their callers ask again the next time the
+ * member or face is shown.
+ */
+void UQQClient::requestFailed(Action action, const UQQRequestContext &context) {
     switch (action) {
-    case CheckCodeAction:
-        verifyCode(data);
-        break;
-    case GetCaptchaAction:
-        saveCaptcha(data);
-        break;
-    case LoginAction:
-        verifyLogin(data);
+    case PollMessageAction:
+        m_pollEngine->finished(UQQPollEngine::Failed);
         break;
-    case LogoutAction:
-        parseLogout(data);
+    case SendBuddyMessageAction:
+    case SendGroupMessageAction:
+    case SendSessionMessageAction:
+        m_sendQueue->finished(context.value, false);
         break;
     case SecondLoginAction:
-        verifySecondLogin(data);
+        if (m_renewing) {
+            m_renewing = false;
+            m_pollEngine->retry();
+        }
         break;
+    default:
+        if (!context.uin.isEmpty() || context.gid)
+            uqqDebug(Net) << action << "failed for" << context.gid << context.uin;
+    }
+}
+
+void UQQClient::handleReply(Action action, const UQQRequestContext &context,
+                            QNetworkReply *reply, const QByteArray &data) {
+    ReplyHandler handler = m_replyHandlers.value(action);
+    if (!handler) {
+        uqqWarning(Net) << "Unknown action:" << action;
+        return;
+    }
+    (this->*handler)(context, reply, data);
+}
+
+template <void (UQQClient::*parse)(const QByteArray &)>
+void UQQClient::replyData(const UQQRequestContext &, QNetworkReply *, const QByteArray &data) {
+    (this->*parse)(data);
+}
+
+template <void (UQQClient::*parse)(const UQQRequestContext &, const QByteArray &)>
+void UQQClient::replyContext(const UQQRequestContext &context, QNetworkReply *, const QByteArray &data) {
+    (this->*parse)(context, data);
+}
+
+/*
+ * The handler of every action and of every poll_type, a new request or
+ * event type only needs an entry here.
+ */
+void UQQClient::initHandlers() {
+    registerReply(CheckCodeAction, &UQQClient::replyData<&UQQClient::verifyCode>);
+    registerReply(GetCaptchaAction, &UQQClient::replyData<&UQQClient::saveCaptcha>);
+    registerReply(LoginAction, &UQQClient::replyData<&UQQClient::verifyLogin>);
+    registerReply(LogoutAction, &UQQClient::replyData<&UQQClient::parseLogout>);
+    registerReply(SecondLoginAction, &UQQClient::replyData<&UQQClient::verifySecondLogin>);
+    registerReply(PollMessageAction, &UQQClient::replyData<&UQQClient::onPollReply>);
+    registerReply(GetMemberAccountAction, &UQQClient::replyContext<&UQQClient::parseMemberAccount>);
+    registerReply(GetGroupAccountAction, &UQQClient::replyContext<&UQQClient::parseGroupAccount>);
+    registerReply(GetLongNickAction, &UQQClient::replyContext<&UQQClient::parseLongNick>);
+    registerReply(GetMemberLevelAction, &UQQClient::replyContext<&UQQClient::parseMemberLevel>);
+    registerReply(GetMemberInfoAction, &UQQClient::replyContext<&UQQClient::parseMemberInfo>);
+    registerReply(GetStrangerInfoAction, &UQQClient::replyContext<&UQQClient::parseStrangerInfo>);
+    registerReply(GetUserFaceAction, &UQQClient::saveFace);
+    registerReply(LoadContactAction, &UQQClient::replyData<&UQQClient::parseContact>);
+    registerReply(GetOnlineBuddiesAction, &UQQClient::replyData<&UQQClient::parseOnlineBuddies>);
+    registerReply(SendBuddyMessageAction, &UQQClient::replyContext<&UQQClient::onMessageSended>);
+    registerReply(SendGroupMessageAction, &UQQClient::replyContext<&UQQClient::onMessageSended>);
+    registerReply(SendSessionMessageAction, &UQQClient::replyContext<&UQQClient::onMessageSended>);
+    registerReply(ChangeStatusAction, &UQQClient::replyContext<&UQQClient::parseChangeStatus>);
+    registerReply(LoadGroupsAction, &UQQClient::replyData<&UQQClient::parseGroups>);
+    registerReply(LoadGroupInfoAction, &UQQClient::replyContext<&UQQClient::parseGroupInfo>);
+    registerReply(GetGroupSigAction, &UQQClient::replyContext<&UQQClient::parseGroupSig>);
+    registerReply(SetGroupMaskAction, &UQQClient::replyContext<&UQQClient::parseGroupMask>);
+
+    registerPollEvent("buddies_status_change", &UQQClient::pollStatusChanged);
+    registerPollEvent("kick_message", &UQQClient::pollKickMessage);
+    registerPollEvent("input_notify", &UQQClient::pollInputNotify);
+    registerPollMessage("message", &UQQClient::pollMemberMessage);
+    registerPollMessage("group_message", &UQQClient::pollGroupMessage);
+    registerPollMessage("sess_message", &UQQClient::pollSessionMessage);
+}
+
+void UQQClient::registerReply(Action action, ReplyHandler handler) {
+    m_replyHandlers.insert(action, handler);
+}
+
+void UQQClient::registerPollEvent(const QByteArray &type, PollEventHandler handler) {
+    PollHandler h;
+    h.event = handler;
+    h.message = Q_NULLPTR;
+    m_pollHandlers.insert(type, h);
+}
+
+void UQQClient::registerPollMessage(const QByteArray &type, PollMessageHandler handler) {
+    PollHandler h;
+    h.event = Q_NULLPTR;
+    h.message = handler;
+    m_pollHandlers.insert(type, h);
+}
+
+/*
+ * Polls, sends and login steps go out at once, faces only when nothing
+ * else is waiting for the host.
+ */
+UQQRequestScheduler::Priority UQQClient::requestPriority(Action action) {
+    switch (action) {
+    case GetUserFaceAction:
+        return UQQRequestScheduler::LowPriority;
+    case GetLongNickAction:
     case GetMemberAccountAction:
-        parseAccount(p.at(0).toULongLong(), p.at(1).toString(), data, GetMemberAccountAction);
-        break;
     case GetGroupAccountAction:
-        parseAccount(p.at(0).toULongLong(), p.at(1).toString(), data, GetGroupAccountAction);
-        break;
-    case GetLongNickAction:
-        parseLongNick(p.at(0).toULongLong(), p.at(1).toString(), data);
-        break;
     case GetMemberLevelAction:
-        parseMemberLevel(p.at(0).toString(), data);
-        break;
     case GetMemberInfoAction:
-        parseMemberInfo(p.at(0).toString(), data);
-        break;
     case GetStrangerInfoAction:
-        parseStrangerInfo(p.at(0).toULongLong(), p.at(1).toString(), data);
-        break;
-    case GetUserFaceAction:
-        saveFace(p.at(0).toULongLong(), p.at(1).toString(), data);
-        break;
     case LoadContactAction:
-        parseContact(data);
-        break;
     case GetOnlineBuddiesAction:
-        parseOnlineBuddies(data);
-        break;
-    case PollMessageAction:
-        parsePoll(data);
-        break;
-    case SendBuddyMessageAction:
-        onMessageSended(p.at(0).toULongLong(), p.at(1).toString(), data);
-        break;
-    case SendGroupMessageAction:
-        onMessageSended(p.at(0).toULongLong(), p.at(1).toString(), data);
-        break;
-    case SendSessionMessageAction:
-        onMessageSended(p.at(0).toULongLong(), p.at(1).toString(), data);
-        break;
-    case ChangeStatusAction:
-        parseChangeStatus(p.at(0).toString(), data);
-        break;
     case LoadGroupsAction:
-        parseGroups(data);
-        break;
     case LoadGroupInfoAction:
-        parseGroupInfo(p.at(0).toULongLong(), data);
-        break;
     case GetGroupSigAction:
-        parseGroupSig(p.at(0).toULongLong(),
-                      p.at(1).toString(),
-                      data);
-        break;
-    case SetGroupMaskAction:
-        parseGroupMask(p.at(0).toULongLong(),
-                       UQQCategory::GroupMessageMask(p.at(1).toInt()),
-                       data);
-        break;
+        return UQQRequestScheduler::NormalPriority;
     default:
-        qWarning() << "Unknown action:" << action;
+        return UQQRequestScheduler::HighPriority;
     }
+}
 
-    reply->deleteLater();
+// per uin (or gid) lookups are coalesced
+QByteArray UQQClient::requestKey(Action action, const UQQRequestContext &context) {
+    switch (action) {
+    case GetUserFaceAction:
+    case GetLongNickAction:
+    case GetMemberAccountAction:
+    case GetGroupAccountAction:
+    case GetMemberLevelAction:
+    case GetMemberInfoAction:
+    case GetStrangerInfoAction:
+    case LoadGroupInfoAction:
+    case GetGroupSigAction:
+        if (!context.uin.isEmpty())
+            return QByteArray::number(action) + ':' + context.uin.toLatin1();
+        if (context.gid != 0)
+            return QByteArray::number(action) + ':' + QByteArray::number(context.gid);
+        break;
+    default:
+        break;
+    }
+    return QByteArray();
 }
 
 void UQQClient::get(Action action, QUrl url,
-                    const QVariantList &attributes,
+                    const UQQRequestContext &context,
                     const RequestHeaderMap &headers) {
     QNetworkRequest request;
 
     request.setUrl(url);
     request.setAttribute(QNetworkRequest::User, action);
-    request.setAttribute(QNetworkRequest::UserMax, attributes);
+    request.setAttribute(QNetworkRequest::UserMax, QVariant::fromValue(context));
+    request.setAttribute(SentAtAttribute, m_metrics.elapsed());
 
     request.setRawHeader("Referer", "http://s.web2.qq.com/proxy.html?v=20110412001&callback=1&id=1");
 
     for (RequestHeaderMap::ConstIterator iter = headers.constBegin(); iter != headers.constEnd(); iter++)
         request.setRawHeader(iter.key(), iter.value());
 
-    m_manager->get(request);
+    m_scheduler->get(request, requestPriority(action), requestKey(action, context));
 }
 
 void UQQClient::post(Action action, QUrl url,
                      const QByteArray &data,
-                     const QVariantList &attributes,
+                     const UQQRequestContext &context,
                      const RequestHeaderMap &headers) {
     QNetworkRequest request;
 
     request.setUrl(url);
     request.setAttribute(QNetworkRequest::User, action);
-    request.setAttribute(QNetworkRequest::UserMax, attributes);
+    request.setAttribute(QNetworkRequest::UserMax, QVariant::fromValue(context));
+    request.setAttribute(SentAtAttribute, m_metrics.elapsed());
 
     request.setRawHeader("Referer", "http://s.web2.qq.com/proxy.html?v=20110412001&callback=1&id=1");
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
@@ -187,29 +330,31 @@ void UQQClient::post(Action action, QUrl url,
     for (RequestHeaderMap::ConstIterator iter = headers.constBegin(); iter != headers.constEnd(); iter++)
         request.setRawHeader(iter.key(), iter.value());
 
-    m_manager->post(request, data);
+    m_scheduler->post(request, data, requestPriority(action), requestKey(action, context));
 }
 
 QVariant UQQClient::getResponseResult(const QByteArray &data, int *retCode) {
+    qint64 start = m_metrics.elapsed();
     QJsonObject obj = QJsonDocument::fromJson(data).object();
     QVariantMap m = obj.toVariantMap();
 
     if (retCode)
         *retCode = m.value("retcode", DefaultError).toInt();
 
+    m_metrics.parsed(m_metrics.elapsed() - start);
     return m.value("result");
 }
 
 void UQQClient::checkCode(QString uin) {
-    qDebug() << "check code...";
+    uqqDebug(Login) << "check code...";
 
-    QUrl url("http://check.ptlogin2.qq.com/check");
+    QUrl url = endpoint("check.ptlogin2.qq.com", "/check");
     QUrlQuery query;
     query.addQueryItem("uin", uin);
     query.addQueryItem("appid", getLoginInfo("aid").toString());
     query.addQueryItem("r", getRandom());
     url.setQuery(query);
-    qDebug() << url.toString();
+    uqqDebug(Login) << url.toString();
 
     addLoginInfo("uin", uin);
 
@@ -217,7 +362,7 @@ void UQQClient::checkCode(QString uin) {
     get(CheckCodeAction, url);
 }
 
-void UQQClient::verifyCode(const QString &data) {
+void UQQClient::verifyCode(const QByteArray &data) {
     QStringList list;
     parseParamList(data, list);
 
@@ -225,28 +370,28 @@ void UQQClient::verifyCode(const QString &data) {
     addLoginInfo("uinHex", list.at(2).toUtf8());
     if (list.at(0).toInt() != NoError) {
         if (list.at(1).length() > 0) {
-            qDebug() << "check code done, code needed.";
+            uqqDebug(Login) << "check code done, code needed.";
             getCaptcha();
         }
         else {
-           qWarning() << data;
+           uqqWarning(Login) << data;
         }
     } else {
-        qDebug() << "check code done, code no needed.";
+        uqqDebug(Login) << "check code done, code no needed.";
         emit captchaChanged(false);
     }
 }
 
 void UQQClient::getCaptcha() {
-    qDebug() << "get captcha...";
+    uqqDebug(Login) << "get captcha...";
 
-    QUrl url("http://captcha.qq.com/getimage");
+    QUrl url = endpoint("captcha.qq.com", "/getimage");
     QUrlQuery query;
     query.addQueryItem("uin", getLoginInfo("uin").toString());
     query.addQueryItem("aid", getLoginInfo("aid").toString());
     query.addQueryItem("r", getRandom());
     url.setQuery(query);
-    qDebug() << url.toString();
+    uqqDebug(Login) << url.toString();
 
     get(GetCaptchaAction, url);
 }
@@ -258,20 +403,22 @@ void UQQClient::saveCaptcha(const QByteArray &data) {
     file.open(QIODevice::WriteOnly | QIODevice::Truncate);
     file.write(data);
     file.close();
-    qDebug() << "get captcha done, captcha saved.";
+    uqqDebug(Login) << "get captcha done, captcha saved.";
     addLoginInfo("captcha", capName);
     emit captchaChanged(true);
 }
 
 void UQQClient::logout() {
-    QUrl url("http://s.web2.qq.com/channel/logout2");
+    m_pollEngine->stop();
+
+    QUrl url = endpoint("s.web2.qq.com", "/channel/logout2");
     QUrlQuery query;
     query.addQueryItem("ids", "");
     query.addQueryItem("clientid", getLoginInfo("clientid").toString());
     query.addQueryItem("psessionid", getLoginInfo("psessionid").toString());
     query.addQueryItem("t", getTimestamp());
     url.setQuery(query);
-    qDebug() << url.toString();
+    uqqDebug(Login) << url.toString();
 
     get(LogoutAction, url);
 }
@@ -282,16 +429,16 @@ void UQQClient::parseLogout(const QByteArray &data) {
 
     int retcode = m.value("retcode", DefaultError).toInt();
     if (retcode == NoError) {
-        qDebug() << "logout ok";
+        uqqDebug(Login) << "logout ok";
     } else {
-        qWarning() << "parseLogout:" << data;
+        uqqWarning(Login) << "parseLogout:" << data;
     }
 }
 
 void UQQClient::login(QString uin, QString pwd, QString vc, QString status) {
-    qDebug() << "request login...";
+    uqqDebug(Login) << "request login...";
 
-    QUrl url("http://ptlogin2.qq.com/login");
+    QUrl url = endpoint("ptlogin2.qq.com", "/login");
     //QUrl u1("http://web.qq.com/loginproxy.html?login2qq=1&webqq_type=10");
     QUrlQuery query;
     query.addQueryItem("u", uin);
@@ -314,7 +461,7 @@ void UQQClient::login(QString uin, QString pwd, QString vc, QString status) {
     query.addQueryItem("g", QString::number(1));
     url.setQuery(query);
     url = QUrl(url.toString().append("&u1=http%3A%2F%2Fweb.qq.com%2Floginproxy.html%3Flogin2qq%3D1%26webqq_type%3D10"));
-    qDebug() << url.toString();
+    uqqDebug(Login) << url.toString();
 
     addLoginInfo("uin", uin);
     addLoginInfo("vc", vc);
@@ -331,10 +478,10 @@ void UQQClient::verifyLogin(const QByteArray &data) {
     parseParamList(data, list);
 
     if ((errCode = list.at(0).toInt()) == NoError) {
-        qDebug() << "login done.";
+        uqqDebug(Login) << "login done.";
         secondLogin();
     } else {
-        qWarning() << data;
+        uqqWarning(Login) << data;
         addLoginInfo("errMsg", list.at(4));
         if (errCode == CaptchaError) {   // get captcha again
             getCaptcha();
@@ -348,14 +495,14 @@ void UQQClient::autoReLogin() {
 }
 
 void UQQClient::secondLogin() {
-    qDebug() << "request second login...";
+    uqqDebug(Login) << "request second login...";
 
-    QUrl url("http://d.web2.qq.com/channel/login2");
-    qDebug() << url.toString();
+    QUrl url = endpoint("d.web2.qq.com", "/channel/login2");
+    uqqDebug(Login) << url.toString();
 
     QString ptwebqq = getCookie("ptwebqq", url);
     addLoginInfo("ptwebqq", ptwebqq);
-    qDebug() << "ptwebqq:" << ptwebqq;
+    uqqDebug(Login) << "ptwebqq:" << ptwebqq;
 
     QVariantMap param;
     param.insert("status", getLoginInfo("status").toString());
@@ -374,7 +521,7 @@ void UQQClient::secondLogin() {
 }
 
 void UQQClient::verifySecondLogin(const QByteArray &data) {
-    qDebug() << "verify second login...";
+    uqqDebug(Login) << "verify second login...";
     const QVariantMap &result = getResponseResult(data).toMap();
 
     if (!result.isEmpty()) {
@@ -386,28 +533,133 @@ void UQQClient::verifySecondLogin(const QByteArray &data) {
         addLoginInfo("vfwebqq", result.value("vfwebqq"));
         addLoginInfo("psessionid", result.value("psessionid"));
 
-        qDebug() << "second login done.";
+        uqqDebug(Login) << "second login done.";
 
+        if (m_renewing) {   // only the session changed, the lists are kept
+            m_renewing = false;
+            m_pollEngine->start(m_pollEngine->overlap());
+            return;
+        }
         onLoginSuccess(getLoginInfo("uin").toString(),
                        result.value("status").toString());
+    } else if (m_renewing) {
+        m_renewing = false;
+        m_pollEngine->retry();
     }
 }
 
+/*
+ * The session timed out (poll retcode 103), log in again with the stored
+ * ptwebqq and carry on polling without reloading contacts and groups.
+ */
+void UQQClient::renewSession() {
+    if (m_renewing) return;
+    uqqDebug(Login) << "poll offline, renew the session...";
+    m_renewing = true;
+    secondLogin();
+}
+
 void UQQClient::onLoginSuccess(const QString &uin, const QString &status) {
     initClient();
     initConfig();
+    m_demands->clear();
+    m_sendQueue->clear();
+    m_pollEngine->stop();
 
     UQQMember *user = new UQQMember(UQQCategory::IllegalCategoryId, uin, m_contact);
-    qDebug() << "login success! status:" << status;
+    uqqDebug(Login) << "login success! status:" << status;
     user->setStatus(UQQMember::statusIndex(status));
     m_contact->addMember(user);
 
-    qDebug() << "get user" << uin << "information";
+    uqqDebug(Login) << "get user" << uin << "information";
     getUserFace();
     getLongNick(UQQCategory::IllegalCategoryId, uin);
     getMemberDetail(UQQCategory::IllegalCategoryId, uin);
 
+    // show what we had last time right away, the requests below reconcile it
+    m_snapshotLoaded = loadSnapshot();
+    if (m_snapshotLoaded) {
+        emit contactReady();
+        emit groupListReady();
+    }
+
+    startLoading();
+}
+
+/*
+ * The contact list, the online buddies and the group list are requested
+ * together instead of one after another. Only the online statuses depend on
+ * the contact list, they are held back until it has been parsed.
+ */
+void UQQClient::startLoading() {
+    m_startupStages = 0;
+    m_pendingOnline.clear();
+
     loadContact();
+    getOnlineBuddies();
+    loadGroups();
+}
+
+void UQQClient::finishStage(StartupStage stage) {
+    if (m_startupStages & stage) return;
+
+    m_startupStages |= stage;
+    if (m_startupStages == AllStages) {
+        uqqDebug(General) << "ALL needed datas are loaded.";
+        emit ready();
+        m_snapshotTimer->start();
+    }
+}
+
+bool UQQClient::loadSnapshot() {
+    QFile file(getConfig("snapshotFile").toString());
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != SnapshotMagic || version != SnapshotVersion) {
+        uqqDebug(General) << "ignore snapshot, version:" << version;
+        return false;
+    }
+
+    // a truncated snapshot still shows what could be read
+    if (!m_contact->load(in) || !m_group->load(in, m_contact))
+        uqqWarning(General) << "Error: read snapshot" << file.fileName();
+    uqqDebug(General) << "snapshot loaded, categories:" << m_contact->categories().size()
+             << "groups:" << m_group->groups().size();
+    return true;
+}
+
+void UQQClient::saveSnapshot() {
+    m_faceCache.save();
+
+    QString fileName = getConfig("snapshotFile").toString();
+    if (fileName.isEmpty()) return;
+
+    // replaces the old snapshot only once the new one is complete
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        uqqWarning(General) << "Error: open snapshot" << file.fileName();
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint32(SnapshotMagic) << quint32(SnapshotVersion);
+    m_contact->save(out);
+    m_group->save(out);
+
+    if (out.status() != QDataStream::Ok) {
+        uqqWarning(General) << "Error: write snapshot" << file.fileName();
+        return;     // not committed, the old snapshot is kept
+    }
+    if (!file.commit()) {
+        uqqWarning(General) << "Error: save snapshot" << file.fileName() << file.errorString();
+        return;
+    }
+    uqqDebug(General) << "snapshot saved.";
 }
 
 void UQQClient::getSimpleInfo(quint64 gid, QString uin) {
@@ -415,7 +667,7 @@ void UQQClient::getSimpleInfo(quint64 gid, QString uin) {
 
     UQQMember *member = this->member(gid, uin);
     if (q_check_ptr(member) && member->isFriend())
-        getLongNick(gid, uin);
+        demandDetail(gid, member, UQQMemberDetail::LongNickPart, false);
 }
 
 void UQQClient::getMemberDetail(quint64 gid, QString uin) {
@@ -424,15 +676,47 @@ void UQQClient::getMemberDetail(quint64 gid, QString uin) {
     if (!q_check_ptr(member)) return;
 
     if (member->isFriend()) {
-        getMemberInfo(uin);
-        getMemberLevel(uin);
+        demandDetail(gid, member, UQQMemberDetail::InfoPart, true);
+        demandDetail(gid, member, UQQMemberDetail::LevelPart, true);
     } else {
         getStrangerInfo(gid, uin);
         if (member->groupSig().isEmpty())
             getGroupSig(gid, uin);
     }
-    getMemberAccount(gid, uin);
+    demandDetail(gid, member, UQQMemberDetail::AccountPart, true);
+
+}
+
+/*
+ * Detail requests go through the demand queue, which drops duplicates and
+ * limits the rate; parts fetched recently are not asked for again.
+ */
+void UQQClient::demandDetail(quint64 gid, UQQMember *member, UQQMemberDetail::Part part, bool urgent) {
+    if (member->detail() && member->detail()->isFresh(part)) return;
+    m_demands->add(part, gid, member->uin(), urgent);
+}
+
+void UQQClient::onDemand(int kind, quint64 gid, const QString &uin) {
+    switch (kind) {
+    case UQQMemberDetail::LongNickPart:
+        getLongNick(gid, uin);
+        break;
+    case UQQMemberDetail::LevelPart:
+        getMemberLevel(uin);
+        break;
+    case UQQMemberDetail::InfoPart:
+        getMemberInfo(uin);
+        break;
+    case UQQMemberDetail::AccountPart:
+        getMemberAccount(gid, uin);
+        break;
+    }
+}
 
+UQQMemberDetail *UQQClient::ensureDetail(UQQMember *member) {
+    if (!member->detail())
+        member->setDetail(new UQQMemberDetail(member));
+    return member->detail();
 }
 
 void UQQClient::getMemberAccount(quint64 gid, const QString &uin) {
@@ -440,13 +724,13 @@ void UQQClient::getMemberAccount(quint64 gid, const QString &uin) {
 }
 
 void UQQClient::getGroupAccount(const QString &uin) {
-    qDebug() << "request group account...";
+    uqqDebug(Group) << "request group account...";
     getAccount(UQQCategory::IllegalCategoryId, uin, GetGroupAccountAction);
 }
 
 void UQQClient::getAccount(quint64 gid, const QString &uin, Action action) {
-    qDebug() << "get account...";
-    QUrl url("http://s.web2.qq.com/api/get_friend_uin2");
+    uqqDebug(Contact) << "get account...";
+    QUrl url = endpoint("s.web2.qq.com", "/api/get_friend_uin2");
     QUrlQuery query;
     query.addQueryItem("tuin", uin);
     query.addQueryItem("verifysession", "");
@@ -455,58 +739,60 @@ void UQQClient::getAccount(quint64 gid, const QString &uin, Action action) {
     query.addQueryItem("vfwebqq", getLoginInfo("vfwebqq").toString());
     query.addQueryItem("t", getTimestamp());
     url.setQuery(query);
-    qDebug() << url.toString();
+    uqqDebug(Contact) << url.toString();
 
-    QVariantList attributes;
-    attributes << gid << uin;
+    UQQRequestContext context(gid, uin);
 
-    TEST(parseAccount(gid, uin, readFile("test/account.txt"), action));
-    get(action, url, attributes);
+    TEST(action == GetMemberAccountAction ?
+             parseMemberAccount(context, readFile("test/account.txt")) :
+             parseGroupAccount(context, readFile("test/account.txt")));
+    get(action, url, context);
 }
 
 /*
  *{"retcode":0,"result":{"uiuin":"","account":123456,"uin":12345668}}
  */
-void UQQClient::parseAccount(quint64 gid, const QString &uin, const QByteArray &data, Action action) {
+void UQQClient::parseMemberAccount(const UQQRequestContext &context, const QByteArray &data) {
     const QVariantMap &result = getResponseResult(data).toMap();
 
     if (!result.isEmpty()) {
-        if (action == GetMemberAccountAction) {
-            UQQMember *member = this->member(gid, uin);
-            if (!q_check_ptr(member)) return;
-
-            UQQMemberDetail *detail = Q_NULLPTR;
-            if ((detail = member->detail()) == Q_NULLPTR) {
-                detail = new UQQMemberDetail(member);
-                member->setDetail(detail);
-            }
-            member->detail()->setAccount(result.value("account").toULongLong());
-            qDebug() << "get account done." << member->detail()->account();
-        } else {
-            UQQCategory *group = m_group->getGroupByCode(uin.toULongLong());
-
-            if (q_check_ptr(group)) {
-                group->setAccount(result.value("account").toULongLong());
-                qDebug() << "request group account done, group" << gid << "account:" << group->account();
-            }
+        UQQMember *member = this->member(context.gid, context.uin);
+        if (!q_check_ptr(member)) return;
+
+        UQQMemberDetail *detail = ensureDetail(member);
+        detail->setAccount(result.value("account").toULongLong());
+        detail->touch(UQQMemberDetail::AccountPart);
+        uqqDebug(Contact) << "get account done." << member->detail()->account();
+    }
+}
+
+// the uin of a group account request is the group code
+void UQQClient::parseGroupAccount(const UQQRequestContext &context, const QByteArray &data) {
+    const QVariantMap &result = getResponseResult(data).toMap();
+
+    if (!result.isEmpty()) {
+        UQQCategory *group = m_group->getGroupByCode(context.uin.toULongLong());
+
+        if (q_check_ptr(group)) {
+            group->setAccount(result.value("account").toULongLong());
+            uqqDebug(Group) << "request group account done, group" << group->id() << "account:" << group->account();
         }
     }
 }
 
 void UQQClient::getLongNick(quint64 gid, const QString &uin) {
-    QUrl url("http://s.web2.qq.com/api/get_single_long_nick2");
+    QUrl url = endpoint("s.web2.qq.com", "/api/get_single_long_nick2");
     QUrlQuery query;
     query.addQueryItem("tuin", uin);
     query.addQueryItem("vfwebqq", getLoginInfo("vfwebqq").toString());
     query.addQueryItem("t", getTimestamp());
     url.setQuery(query);
-    //qDebug() << url.toString();
+    //uqqDebug(Contact) << url.toString();
 
-    QVariantList attributes;
-    attributes << gid << uin;
+    UQQRequestContext context(gid, uin);
 
-    TEST(parseLongNick(gid, uin, readFile("test/lnick.txt")));
-    get(GetLongNickAction, url, attributes);
+    TEST(parseLongNick(context, readFile("test/lnick.txt")));
+    get(GetLongNickAction, url, context);
 }
 
 /*
@@ -514,33 +800,34 @@ void UQQClient::getLongNick(quint64 gid, const QString &uin) {
  * long nick json format:
  * {"retcode":0,"result":[{"uin":1279450562,"lnick":"123456"}]}
  */
-void UQQClient::parseLongNick(quint64 gid, const QString &uin, const QByteArray &data) {
+void UQQClient::parseLongNick(const UQQRequestContext &context, const QByteArray &data) {
     const QVariantList &result = getResponseResult(data).toList();
 
     UQQMember *member = Q_NULLPTR;
 
     if (!result.isEmpty()) {
         const QVariantMap &m = result.at(0).toMap();
-        member = this->member(gid, uin);
+        member = this->member(context.gid, context.uin);
 
-        if (q_check_ptr(member))
+        if (q_check_ptr(member)) {
             member->setLongnick(m.value("lnick").toString());
+            ensureDetail(member)->touch(UQQMemberDetail::LongNickPart);
+        }
     }
 }
 
 void UQQClient::getMemberLevel(const QString &uin) {
-    QUrl url("http://s.web2.qq.com/api/get_qq_level2");
+    QUrl url = endpoint("s.web2.qq.com", "/api/get_qq_level2");
     QUrlQuery query;
     query.addQueryItem("tuin", uin);
     query.addQueryItem("vfwebqq", getLoginInfo("vfwebqq").toString());
     url.setQuery(query);
-    qDebug() << url.toString();
+    uqqDebug(Contact) << url.toString();
 
-    QVariantList attributes;
-    attributes << uin;
+    UQQRequestContext context(UQQCategory::IllegalCategoryId, uin);
 
-    TEST(parseMemberLevel(uin, readFile("test/level.txt")));
-    get(GetMemberLevelAction, url, attributes);
+    TEST(parseMemberLevel(context, readFile("test/level.txt")));
+    get(GetMemberLevelAction, url, context);
 }
 
 /*
@@ -549,37 +836,33 @@ void UQQClient::getMemberLevel(const QString &uin) {
     "result":{"level":40,"days":1802,"hours":13476,"remainDays":43,"tuin":121830387}
 }
 */
-void UQQClient::parseMemberLevel(const QString &uin, const QByteArray &data) {
-    UQQMember *member = this->member(UQQCategory::IllegalCategoryId, uin);
-    UQQMemberDetail *detail = Q_NULLPTR;
+void UQQClient::parseMemberLevel(const UQQRequestContext &context, const QByteArray &data) {
+    UQQMember *member = this->member(UQQCategory::IllegalCategoryId, context.uin);
     const QVariantMap &result = getResponseResult(data).toMap();
 
     if (!result.isEmpty() && q_check_ptr(member)) {
-        if ((detail = member->detail()) == Q_NULLPTR) {
-            detail = new UQQMemberDetail(member);
-            member->setDetail(detail);
-        }
-        member->detail()->setLevel(result.value("level").toInt());
-        member->detail()->setLevelDays(result.value("days").toInt());
-        member->detail()->setLevelHours(result.value("hours").toInt());
-        member->detail()->setLevelRemainDays(result.value("remainDays").toInt());
+        UQQMemberDetail *detail = ensureDetail(member);
+        detail->setLevel(result.value("level").toInt());
+        detail->setLevelDays(result.value("days").toInt());
+        detail->setLevelHours(result.value("hours").toInt());
+        detail->setLevelRemainDays(result.value("remainDays").toInt());
+        detail->touch(UQQMemberDetail::LevelPart);
     }
 }
 
 void UQQClient::getMemberInfo(const QString &uin) {
-    QUrl url("http://s.web2.qq.com/api/get_friend_info2");
+    QUrl url = endpoint("s.web2.qq.com", "/api/get_friend_info2");
     QUrlQuery query;
     query.addQueryItem("tuin", uin);
     query.addQueryItem("vfwebqq", getLoginInfo("vfwebqq").toString());
     query.addQueryItem("t", getTimestamp());
     url.setQuery(query);
-    qDebug() << url.toString();
+    uqqDebug(Contact) << url.toString();
 
-    QVariantList attributes;
-    attributes << uin;
+    UQQRequestContext context(UQQCategory::IllegalCategoryId, uin);
 
-    TEST(parseMemberInfo(uin, readFile("test/user.txt")))
-    get(GetMemberInfoAction, url, attributes);
+    TEST(parseMemberInfo(context, readFile("test/user.txt")))
+    get(GetMemberInfoAction, url, context);
 }
 
 /*
@@ -592,61 +875,64 @@ void UQQClient::getMemberInfo(const QString &uin) {
     "nick":"","shengxiao":1,"email":"","province":"","gender":"","mobile":""}
 }
 */
-void UQQClient::parseMemberInfo(const QString &uin, const QByteArray &data) {
+void UQQClient::parseMemberInfo(const UQQRequestContext &context, const QByteArray &data) {
     const QVariantMap &result = getResponseResult(data).toMap();
     UQQMember *member = Q_NULLPTR;
 
     if (!result.isEmpty()) {
-        member = this->member(UQQCategory::IllegalCategoryId, uin);
-        if (q_check_ptr(member)) setMemberDetail(member, result);
+        member = this->member(UQQCategory::IllegalCategoryId, context.uin);
+        if (q_check_ptr(member)) {
+            setMemberDetail(member, result);
+            member->detail()->touch(UQQMemberDetail::InfoPart);
+        }
     }
 }
 
 void UQQClient::getStrangerInfo(quint64 gid, const QString &uin) {
-    qDebug() << "get stranger info...";
-    QUrl url("http://s.web2.qq.com/api/get_stranger_info2");
+    uqqDebug(Contact) << "get stranger info...";
+    QUrl url = endpoint("s.web2.qq.com", "/api/get_stranger_info2");
     QUrlQuery query;
     query.addQueryItem("tuin", uin);
     query.addQueryItem("vfwebqq", getLoginInfo("vfwebqq").toString());
     query.addQueryItem("t", getTimestamp());
     url.setQuery(query);
-    qDebug() << url.toString();
+    uqqDebug(Contact) << url.toString();
 
-    QVariantList attributes;
-    attributes << gid << uin;
+    UQQRequestContext context(gid, uin);
 
-    TEST(parseStrangerInfo(gid, uin, readFile("test/user.txt")));
-    get(GetStrangerInfoAction, url, attributes);
+    TEST(parseStrangerInfo(context, readFile("test/user.txt")));
+    get(GetStrangerInfoAction, url, context);
 }
 
-void UQQClient::parseStrangerInfo(quint64 gid, const QString &uin, const QByteArray &data) {
+void UQQClient::parseStrangerInfo(const UQQRequestContext &context, const QByteArray &data) {
     const QVariantMap &result = getResponseResult(data).toMap();
     UQQMember *member = Q_NULLPTR;
+    quint64 gid = context.gid;
+    const QString &uin = context.uin;
 
     if (!result.isEmpty()) {
         if ((member = this->member(gid, uin)) == Q_NULLPTR) {
             member = new UQQMember(gid, uin, m_contact);
-            QList<UQQMessage *> messages = m_contact->getSessMessage(uin);
-            UQQMessage *message;
-            foreach(message, messages) {
-                message->setParent(member);
-                message->setName(member->card() == "" ? member->nickname() : member->card());
+            QList<UQQMessage> messages = m_contact->takeSessMessages(uin.toULongLong());
+            for (int i = 0; i < messages.size(); i++) {
+                UQQMessage message = messages.at(i);
+                message.setName(member->card() == "" ? member->nickname() : member->card());
                 member->addMessage(message);
             }
 
             if (messages.size() > 0)
-                qDebug() << "stranger has messages:" << messages.size();
+                uqqDebug(Contact) << "stranger has messages:" << messages.size();
 
             m_contact->addMember(member);
         }
-        qDebug() << "get stranger info done.";
+        uqqDebug(Contact) << "get stranger info done.";
         setMemberDetail(member, result);
     }
 }
 
 void UQQClient::setMemberDetail(UQQMember *member, const QVariantMap &m) {
     UQQMemberDetail *detail = Q_NULLPTR;
-    qDebug() << "set member detail...";
+    uqqDebug(Contact) << "set member detail...";
     member->setNickname(m.value("nick").toString());
     //member->setStatus(m.value("stat").toInt() / 10);
 
@@ -683,10 +969,14 @@ void UQQClient::setMemberDetail(UQQMember *member, const QVariantMap &m) {
     }
 
     member->setDetail(detail);
-    qDebug() << "set member detail done.";
+    uqqDebug(Contact) << "set member detail done.";
 }
 
 UQQMember *UQQClient::member(quint64 gid, const QString &uin) {
+    return member(gid, uin.toULongLong());
+}
+
+UQQMember *UQQClient::member(quint64 gid, UQQUin uin) {
     UQQMember *member = Q_NULLPTR;
     UQQCategory *cat = Q_NULLPTR;
 
@@ -709,7 +999,7 @@ void UQQClient::testGetFace(quint64 gid, const QString &uin) {
 }
 
 void UQQClient::getFace(quint64 gid, const QString &uin, int cache, int type) {
-    QUrl url(QString("http://face%1.qun.qq.com/cgi/svr/face/getface").arg(QString::number(qrand() % 10 + 1)));
+    QUrl url = endpoint(QString("face%1.qun.qq.com").arg(m_random.bounded(10) + 1), "/cgi/svr/face/getface");
     QUrlQuery query;
     query.addQueryItem("cache", QString::number(cache));
     query.addQueryItem("type", QString::number(type));
@@ -717,51 +1007,63 @@ void UQQClient::getFace(quint64 gid, const QString &uin, int cache, int type) {
     query.addQueryItem("vfwebqq", getLoginInfo("vfwebqq").toString());
     url.setQuery(query);
 
-    QVariantList attributes;
-    attributes << gid << uin;
+    UQQRequestContext context(gid, uin);
 
     TEST(testGetFace(gid, uin));
-    get(GetUserFaceAction, url, attributes);
-}
 
-void UQQClient::saveFace(quint64 gid, const QString &uin, const QByteArray &data) {
-    QString facePath = getConfig("facePath").toString();
-    UQQMember *member = this->member(gid, uin);
+    UQQUin key = uin.toULongLong();
+    QString path = m_faceCache.face(key);
+    if (!path.isEmpty()) {
+        UQQMember *member = this->member(gid, uin);
+        if (member)
+            member->setFace(path);
+        if (m_faceCache.isFresh(key)) return;
+    }
+    get(GetUserFaceAction, url, context, m_faceCache.validators(key));
+}
 
-    if (!q_check_ptr(member)) return;
-    QString path = facePath + "/" + uin + imageFormat(data);
+void UQQClient::saveFace(const UQQRequestContext &context, QNetworkReply *reply, const QByteArray &data) {
+    QString path;
+    const QString &uin = context.uin;
 
-    QFile file(path);
-    file.open(QIODevice::WriteOnly | QIODevice::Truncate);
-    file.write(data);
-    file.close();
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304) {
+        path = m_faceCache.revalidate(uin.toULongLong());
+    } else if (!data.isEmpty()) {
+        path = m_faceCache.store(uin.toULongLong(), data, imageFormat(data),
+                                 reply->rawHeader("ETag"), reply->rawHeader("Last-Modified"));
+    }
+    if (path.isEmpty()) return;
+    m_snapshotTimer->start();   // the face index is saved along with the snapshot
 
-    member->setFace(path);
+    UQQMember *member = this->member(context.gid, uin);
+    if (member)
+        member->setFace(path);
 }
 
 void UQQClient::changeStatus(QString status) {
-    QUrl url("http://d.web2.qq.com/channel/change_status2");
+    QUrl url = endpoint("d.web2.qq.com", "/channel/change_status2");
     QUrlQuery query;
     query.addQueryItem("newstatus", status);
     query.addQueryItem("clientid", getLoginInfo("clientid").toString());
     query.addQueryItem("psessionid", getLoginInfo("psessionid").toString());
     query.addQueryItem("t", getTimestamp());
     url.setQuery(query);
-    qDebug() << url.toString();
+    uqqDebug(Contact) << url.toString();
 
-    QVariantList attributes;
-    attributes << status;
+    UQQRequestContext context;
+    context.text = status;
 
-    TEST(parseChangeStatus(status, readFile("test/retok.txt")));
-    get(ChangeStatusAction, url, attributes);
+    TEST(parseChangeStatus(context, readFile("test/retok.txt")));
+    get(ChangeStatusAction, url, context);
 }
 
-void UQQClient::parseChangeStatus(const QString &status, const QByteArray &data) {
+void UQQClient::parseChangeStatus(const UQQRequestContext &context, const QByteArray &data) {
+    const QString &status = context.text;
     int retCode = 0;
     getResponseResult(data, &retCode);
 
     if (retCode == NoError) {
-        qDebug() << "change status ok:" << status;
+        uqqDebug(Contact) << "change status ok:" << status;
         QString uin = getLoginInfo("uin").toString();
         UQQMember *user = this->member(UQQCategory::IllegalCategoryId, uin);
         if (q_check_ptr(user)) {
@@ -808,9 +1110,9 @@ QString UQQClient::hashFriends(char *uin, char *ptwebqq) {
 }
 
 void UQQClient::loadContact() {
-    qDebug() << "request contact list...";
+    uqqDebug(Contact) << "request contact list...";
     QVariantMap param;
-    QUrl url("http://s.web2.qq.com/api/get_user_friends2");
+    QUrl url = endpoint("s.web2.qq.com", "/api/get_user_friends2");
 
     param.insert("h", "hello");
     param.insert("hash", hashFriends(getLoginInfo("uin").toString().toLatin1().data(), getLoginInfo("ptwebqq").toString().toLatin1().data()));
@@ -830,20 +1132,25 @@ void UQQClient::parseContact(const QByteArray &data) {
     if (retCode == NoError) {
         if (!result.isEmpty())
             m_contact->setContactData(result);
-        qDebug() << "contact list ready.";
-        getOnlineBuddies();
+        if (!m_pendingOnline.isEmpty()) {
+            m_contact->setOnlineBuddies(m_pendingOnline);
+            m_pendingOnline.clear();
+        }
+        uqqDebug(Contact) << "contact list ready.";
+        emit contactReady();
+        finishStage(ContactStage);
     }
 }
 
 void UQQClient::getOnlineBuddies() {
-    qDebug() << "request online buddies...";
-    QUrl url("http://d.web2.qq.com/channel/get_online_buddies2");
+    uqqDebug(Contact) << "request online buddies...";
+    QUrl url = endpoint("d.web2.qq.com", "/channel/get_online_buddies2");
     QUrlQuery query;
     query.addQueryItem("clientid", getLoginInfo("clientid").toString());
     query.addQueryItem("psessionid", getLoginInfo("psessionid").toString());
     query.addQueryItem("t", getTimestamp());
     url.setQuery(query);
-    qDebug() << url.toString();
+    uqqDebug(Contact) << url.toString();
 
     TEST(parseOnlineBuddies(readFile("test/status.txt")));
     get(GetOnlineBuddiesAction, url);
@@ -857,16 +1164,21 @@ void UQQClient::parseOnlineBuddies(const QByteArray &data) {
     const QVariantList &result = getResponseResult(data, &retCode).toList();
 
     if (retCode == NoError) {
-        if (!result.isEmpty())
+        if (m_startupStages & ContactStage) {
             m_contact->setOnlineBuddies(result);
-        qDebug() << "request online buddies done.";
-        loadGroups();
+        } else {    // the contact list is still on its way, applied again once it is in
+            if (m_snapshotLoaded)
+                m_contact->setOnlineBuddies(result);
+            m_pendingOnline = result;
+        }
+        uqqDebug(Contact) << "request online buddies done.";
+        finishStage(OnlineStage);
     }
 }
 
 void UQQClient::loadGroups() {
-    qDebug() << "request group list...";
-    QUrl url("http://s.web2.qq.com/api/get_group_name_list_mask2");
+    uqqDebug(Group) << "request group list...";
+    QUrl url = endpoint("s.web2.qq.com", "/api/get_group_name_list_mask2");
 
     QVariantMap param;
     QJsonDocument doc;
@@ -885,33 +1197,33 @@ void UQQClient::parseGroups(const QByteArray &data) {
     if (retCode == NoError) {
         if (!result.isEmpty())
             m_group->setGroupData(result);
-        qDebug() << "request group list done.";
-        qDebug() << "ALL needed datas are loaded, now show the main page.";
-        emit ready();
+        uqqDebug(Group) << "request group list done.";
+        emit groupListReady();
+        finishStage(GroupStage);
     }
 }
 
 void UQQClient::loadGroupInfo(quint64 gid) {
-    qDebug() << "request group info..." << gid;
+    uqqDebug(Group) << "request group info..." << gid;
     UQQCategory *group = m_group->getGroupById(gid);
     if (!q_check_ptr(group)) return;
 
-    QUrl url("http://s.web2.qq.com/api/get_group_info_ext2");
+    QUrl url = endpoint("s.web2.qq.com", "/api/get_group_info_ext2");
     QUrlQuery query;
     query.addQueryItem("gcode", QString::number(group->code()));
     query.addQueryItem("vfwebqq", getLoginInfo("vfwebqq").toString());
     query.addQueryItem("t", getTimestamp());
     url.setQuery(query);
-    qDebug() << url.toString();
+    uqqDebug(Group) << url.toString();
 
-    QVariantList attributes;
-    attributes << gid;
+    UQQRequestContext context(gid);
 
-    TEST(parseGroupInfo(gid, readFile("test/groupinfo02.txt")));
-    get(LoadGroupInfoAction, url, attributes);
+    TEST(parseGroupInfo(context, readFile("test/groupinfo02.txt")));
+    get(LoadGroupInfoAction, url, context);
 }
 
-void UQQClient::parseGroupInfo(quint64 gid, const QByteArray &data) {
+void UQQClient::parseGroupInfo(const UQQRequestContext &context, const QByteArray &data) {
+    quint64 gid = context.gid;
     int retCode = NoError;
     const QVariantMap &result = getResponseResult(data, &retCode).toMap();
 
@@ -919,8 +1231,9 @@ void UQQClient::parseGroupInfo(quint64 gid, const QByteArray &data) {
         if (!result.isEmpty())
             m_group->setGroupDetail(gid, result, m_contact);
         emit groupReady(gid);
+        m_snapshotTimer->start();
 
-        qDebug() << "request group" << gid << "info done.";
+        uqqDebug(Group) << "request group" << gid << "info done.";
 
         UQQCategory *group = m_group->getGroupById(gid);
         if (!q_check_ptr(group)) return;
@@ -930,7 +1243,7 @@ void UQQClient::parseGroupInfo(quint64 gid, const QByteArray &data) {
 }
 
 void UQQClient::setGroupMask(quint64 gid, int mask) {
-    QUrl url("http://cgi.web2.qq.com/keycgi/qqweb/uac/messagefilter.do");
+    QUrl url = endpoint("cgi.web2.qq.com", "/keycgi/qqweb/uac/messagefilter.do");
     QUrlQuery query;
     query.addQueryItem("retype", QString::number(1));
     query.addQueryItem("app", "EQQ");
@@ -949,97 +1262,58 @@ void UQQClient::setGroupMask(quint64 gid, int mask) {
     query.addQueryItem("itemlist", doc.toJson());
     const QString &p = query.toString(QUrl::FullyDecoded);
 
-    qDebug() << url.toString();
-    //qDebug() << p;
+    uqqDebug(Group) << url.toString();
+    //uqqDebug(Group) << p;
 
-    QVariantList attributes;
-    attributes << gid << mask;
+    UQQRequestContext context(gid, QString(), mask);
 
-    TEST(parseGroupMask(gid, mask, readFile("test/retok.txt")));
-    post(SetGroupMaskAction, url, QUrl::toPercentEncoding(p, "=&"), attributes);
+    TEST(parseGroupMask(context, readFile("test/retok.txt")));
+    post(SetGroupMaskAction, url, QUrl::toPercentEncoding(p, "=&"), context);
 }
 
-void UQQClient::parseGroupMask(quint64 gid,
-                                 int mask,
-                                 const QByteArray &data) {
+void UQQClient::parseGroupMask(const UQQRequestContext &context, const QByteArray &data) {
     UQQCategory *group;
     int retCode = NoError;
     getResponseResult(data, &retCode).toMap();
 
     if (retCode == NoError) {
-        group = m_group->getGroupById(gid);
-        group->setMessageMask(UQQCategory::GroupMessageMask(mask));
+        group = m_group->getGroupById(context.gid);
+        if (q_check_ptr(group))
+            group->setMessageMask(UQQCategory::GroupMessageMask(context.value));
     }
 }
 
-/*
- * "content":"[\"hello\",[\"face\",1],\"world\",
- * [\"font\",{\"name\":\"宋体\",\"size\":\"10\",\"style\":[0,0,0],\"color\":\"000000\"}]]"
- */
-QString UQQClient::makeContent(const QString &content) {
-    QString result = "[";
-    QString msg(content);
-    QRegExp facePattern("\\[face\\d{1,3}\\]");
-    QString faceContent;
-    int pos = 0;
-    QString fontContent = QString("[\"font\",{\"name\":\"Arial\",\"size\":\"10\",\"style\":[0,0,0],\"color\":\"000000\"}]");
-
-    while (!msg.isEmpty()) {
-        pos = msg.indexOf(facePattern);
-        if (pos < 0) {
-            result.append("\"").append(msg).append("\",");
-            msg.clear();
-        } else {
-            if (pos > 0) {      // append the text before the face
-                result.append("\"").append(msg.left(pos)).append("\",");
-                msg.remove(0, pos); // discard the text before the face
-            }
-            pos = msg.indexOf(']');
-            if (pos < 0) qWarning() << "face content unnormal.";
-            Q_ASSERT(pos > 0);
-            faceContent = msg.left(pos);    // exclude the last ']' character
-            result.append("[\"face\",").append(faceContent.mid(5)).append("],"); // get the face id;
-            msg.remove(0, pos + 1); // remove the face content
-        }
-    }
-
-    result.append(fontContent).append("]");
-    //qDebug() << result;
-
-    return result;
-}
-
-QString UQQClient::buddyMessageData(QString dstUin, QString content) {
+QString UQQClient::buddyMessageData(QString dstUin, QString content, int msgId) {
     UQQMember *user = this->member(UQQCategory::IllegalCategoryId, getLoginInfo("uin").toString());
     if (!q_check_ptr(user)) return "";
 
     QJsonObject obj;
     obj.insert("to", dstUin);
     obj.insert("face", QString::number(user->detail()->faceid()));
-    obj.insert("msg_id", QString::number(getRandomInt(10000000)));
+    obj.insert("msg_id", QString::number(msgId));
     obj.insert("clientid", getLoginInfo("clientid").toString());
     obj.insert("psessionid", getLoginInfo("psessionid").toString());
 
-    obj.insert("content", makeContent(content));
+    obj.insert("content", m_contentCodec.encode(content));
 
     QJsonDocument doc(obj);
     return doc.toJson();
 }
 
-QString UQQClient::groupMessageData(QString groupUin, QString content) {
+QString UQQClient::groupMessageData(QString groupUin, QString content, int msgId) {
     QJsonObject obj;
     obj.insert("group_uin", groupUin);
-    obj.insert("msg_id", QString::number(getRandomInt(10000000)));
+    obj.insert("msg_id", QString::number(msgId));
     obj.insert("clientid", getLoginInfo("clientid").toString());
     obj.insert("psessionid", getLoginInfo("psessionid").toString());
 
-    obj.insert("content", makeContent(content));
+    obj.insert("content", m_contentCodec.encode(content));
 
     QJsonDocument doc(obj);
     return doc.toJson();
 }
 
-QString UQQClient::sessionMessageData(quint64 gid, const QString &dstUin, const QString &content) {
+QString UQQClient::sessionMessageData(quint64 gid, const QString &dstUin, const QString &content, int msgId) {
     UQQMember *user = this->member(UQQCategory::IllegalCategoryId, getLoginInfo("uin").toString());
     if (!q_check_ptr(user)) return "";
     UQQMember *member = this->member(gid, dstUin);
@@ -1049,11 +1323,11 @@ QString UQQClient::sessionMessageData(quint64 gid, const QString &dstUin, const
     obj.insert("to", dstUin);
     obj.insert("group_sig", member->groupSig());
     obj.insert("face", QString::number(user->detail()->faceid()));
-    obj.insert("msg_id", QString::number(getRandomInt(10000000)));
+    obj.insert("msg_id", QString::number(msgId));
     obj.insert("clientid", getLoginInfo("clientid").toString());
     obj.insert("psessionid", getLoginInfo("psessionid").toString());
 
-    obj.insert("content", makeContent(content));
+    obj.insert("content", m_contentCodec.encode(content));
 
     QJsonDocument doc(obj);
     return doc.toJson();
@@ -1070,73 +1344,65 @@ r={
   }&clientid=123456&psessionid=....
 */
 void UQQClient::sendBuddyMessage(QString dstUin, QString content) {
-    QUrl url("http://d.web2.qq.com/channel/send_buddy_msg2");
-    QString p = "r=" + buddyMessageData(dstUin, content);
-    p.append(QString("&clientid=%1&psessionid=%2").arg(getLoginInfo("clientid").toString(), getLoginInfo("psessionid").toString()));
-
     QString fromUin = getLoginInfo("uin").toString();
     UQQMember *member = this->member(UQQCategory::IllegalCategoryId, dstUin);
     if (!q_check_ptr(member)) return;
 
-    UQQMessage *message = new UQQMessage(member);
-    message->setType(TYPE_SEND);
-    message->setSrc(fromUin);
-    message->setDst(dstUin);
-    message->setContent(content);
-    message->setTime(QDateTime::currentDateTime());
+    UQQMessage message;
+    message.setType(TYPE_SEND);
+    message.setId(nextMsgId());
+    message.setState(UQQMessage::QueuedState);
+    message.setSrc(fromUin.toULongLong());
+    message.setDst(dstUin.toULongLong());
+    message.setContent(content);
+    message.setTime(QDateTime::currentDateTime());
 
     UQQMember *user = this->member(UQQCategory::IllegalCategoryId, fromUin);
     if (q_check_ptr(user))
-        message->setName(user->nickname());
+        message.setName(user->nickname());
     member->addMessage(message);
 
-    QVariantList attributes;
-    attributes << UQQCategory::IllegalCategoryId << dstUin;
-
-    TEST(onMessageSended(member->gid(), member->uin(), readFile("test/retok.txt")));
-    post(SendBuddyMessageAction, url, QUrl::toPercentEncoding(p, "=&"), attributes);
+    m_sendQueue->enqueue(SendBuddyMessageAction, UQQCategory::IllegalCategoryId, dstUin,
+                         content, message.id());
 }
 
-void UQQClient::onMessageSended(quint64 gid, const QString &uin, const QByteArray &data) {
+void UQQClient::onMessageSended(const UQQRequestContext &context, const QByteArray &data) {
     int retCode = NoError;
     getResponseResult(data, &retCode);
 
     if (retCode == NoError) {
-        qDebug() << "gid:" << gid << "uin:" << uin;
-        qDebug() << QTime::currentTime().toString("hh:mm:ss") << "send ok";
+        uqqDebug(Message) << "gid:" << context.gid << "uin:" << context.uin;
+        uqqDebug(Message) << "send ok";
+    } else {
+        uqqWarning(Message) << "onMessageSended:" << data;
     }
+    m_sendQueue->finished(context.value, retCode == NoError);
 }
 
 void UQQClient::sendGroupMessage(quint64 gid, QString content) {
-    qDebug() << QTime::currentTime().toString("hh:mm:ss") << "send group message...";
+    uqqDebug(Message) << "send group message...";
 
     UQQCategory *group = m_group->getGroupById(gid);
     if (!q_check_ptr(group)) return;
 
-    UQQMessage *message = new UQQMessage(group);
+    UQQMessage message;
     QString fromUin = getLoginInfo("uin").toString();
-    message->setType(TYPE_SEND);
-    message->setSrc(fromUin);
-    message->setDst(QString::number(gid));
-    message->setContent(content);
-    message->setTime(QDateTime::currentDateTime());
+    message.setType(TYPE_SEND);
+    message.setId(nextMsgId());
+    message.setState(UQQMessage::QueuedState);
+    message.setSrc(fromUin.toULongLong());
+    message.setDst(gid);
+    message.setContent(content);
+    message.setTime(QDateTime::currentDateTime());
     group->addMessage(message);
 
-    QUrl url("http://d.web2.qq.com/channel/send_qun_msg2");
-    QString p = "r=" + groupMessageData(QString::number(gid), content);
-    p.append(QString("&clientid=%1&psessionid=%2").arg(getLoginInfo("clientid").toString(), getLoginInfo("psessionid").toString()));
-
-    QVariantList attributes;
-    attributes << gid;
-
-    TEST(onMessageSended(gid, QString::number(gid), readFile("test/retok.txt")));
-    post(SendGroupMessageAction, url, QUrl::toPercentEncoding(p, "=&"), attributes);
+    m_sendQueue->enqueue(SendGroupMessageAction, gid, QString(), content, message.id());
 }
 
 void UQQClient::getGroupSig(quint64 gid, QString dstUin) {
-    qDebug() << "request group sig...";
+    uqqDebug(Message) << "request group sig...";
 
-    QUrl url("http://d.web2.qq.com/channel/get_c2cmsg_sig2");
+    QUrl url = endpoint("d.web2.qq.com", "/channel/get_c2cmsg_sig2");
     QUrlQuery query;
     query.addQueryItem("id", QString::number(gid));
     query.addQueryItem("to_uin", dstUin);
@@ -1145,30 +1411,29 @@ void UQQClient::getGroupSig(quint64 gid, QString dstUin) {
     query.addQueryItem("psessionid", getLoginInfo("psessionid").toString());
     query.addQueryItem("t", getTimestamp());
     url.setQuery(query);
-    qDebug() << url.toString();
+    uqqDebug(Message) << url.toString();
 
-    QVariantList attributes;
-    attributes << gid << dstUin;
+    UQQRequestContext context(gid, dstUin);
 
-    TEST(parseGroupSig(gid, dstUin, readFile("test/group_sig.txt")));
-    get(GetGroupSigAction, url, attributes);
+    TEST(parseGroupSig(context, readFile("test/group_sig.txt")));
+    get(GetGroupSigAction, url, context);
 }
 
-void UQQClient::parseGroupSig(quint64 gid, const QString &dstUin, const QByteArray &data) {
+void UQQClient::parseGroupSig(const UQQRequestContext &context, const QByteArray &data) {
     UQQMember *member = Q_NULLPTR;
     const QVariantMap &result = getResponseResult(data).toMap();
 
     if (!result.isEmpty()) {
-        member = this->member(gid, dstUin);
+        member = this->member(context.gid, context.uin);
 
         if (q_check_ptr(member))
             member->setGroupSig(result.value("value").toString());
-        qDebug() << "request group sig done.";
+        uqqDebug(Message) << "request group sig done.";
     }
 }
 
 void UQQClient::sendSessionMessage(quint64 gid, QString dstUin, QString content) {
-    qDebug() << "send session message...";
+    uqqDebug(Message) << "send session message...";
     QString fromUin = getLoginInfo("uin").toString();
     UQQCategory *group = m_group->getGroupById(gid);
     if (!q_check_ptr(group)) return;
@@ -1176,36 +1441,160 @@ void UQQClient::sendSessionMessage(quint64 gid, QString dstUin, QString content)
     UQQMember *member = group->member(dstUin);
     if (!q_check_ptr(member)) return;
 
-    QUrl url("http://d.web2.qq.com/channel/send_sess_msg2");
-    QString p = "r=" + sessionMessageData(gid, dstUin, content);
-    p.append(QString("&clientid=%1&psessionid=%2").arg(getLoginInfo("clientid").toString(), getLoginInfo("psessionid").toString()));
-
     if (member->groupSig().isEmpty()) {
-        qWarning() << "group sig is empty";
+        uqqWarning(Message) << "group sig is empty";
         return;
     }
 
-    UQQMessage *message = new UQQMessage(member);
-    message->setType(TYPE_SEND);
-    message->setSrc(fromUin);
-    message->setDst(dstUin);
-    message->setContent(content);
-    message->setTime(QDateTime::currentDateTime());
+    UQQMessage message;
+    message.setType(TYPE_SEND);
+    message.setId(nextMsgId());
+    message.setState(UQQMessage::QueuedState);
+    message.setSrc(fromUin.toULongLong());
+    message.setDst(dstUin.toULongLong());
+    message.setContent(content);
+    message.setTime(QDateTime::currentDateTime());
     member->addMessage(message);
 
-    QVariantList attributes;
-    attributes << gid << dstUin;
+    m_sendQueue->enqueue(SendSessionMessageAction, gid, dstUin, content, message.id());
+}
+
+/*
+ * Posts a message handed out by the send queue. The request data is built
+ * for every attempt, the session may have been renewed since the last one.
+ */
+void UQQClient::sendQueued(int kind, quint64 gid, const QString &uin, const QString &content, int msgId) {
+    QUrl url;
+    QString p;
+
+    switch (kind) {
+    case SendBuddyMessageAction:
+        url = endpoint("d.web2.qq.com", "/channel/send_buddy_msg2");
+        p = buddyMessageData(uin, content, msgId);
+        break;
+    case SendGroupMessageAction:
+        url = endpoint("d.web2.qq.com", "/channel/send_qun_msg2");
+        p = groupMessageData(QString::number(gid), content, msgId);
+        break;
+    case SendSessionMessageAction:
+        url = endpoint("d.web2.qq.com", "/channel/send_sess_msg2");
+        p = sessionMessageData(gid, uin, content, msgId);
+        break;
+    }
+    if (p.isEmpty()) {  // the member is gone
+        m_sendQueue->finished(msgId, false);
+        return;
+    }
+
+    p = "r=" + p;
+    p.append(QString("&clientid=%1&psessionid=%2").arg(getLoginInfo("clientid").toString(), getLoginInfo("psessionid").toString()));
+    UQQRequestContext context(gid, uin, msgId);
+
+    TEST(onMessageSended(context, readFile("test/retok.txt")));
+    post(Action(kind), url, QUrl::toPercentEncoding(p, "=&"), context);
+}
+
+void UQQClient::onSendStateChanged(int kind, quint64 gid, const QString &uin, int msgId, int state) {
+    QObject *messages = Q_NULLPTR;
+
+    if (kind == SendGroupMessageAction) {
+        UQQCategory *group = m_group->getGroupById(gid);
+        if (group) messages = group->messages();
+    } else {
+        UQQMember *member = this->member(gid, uin);
+        if (member) messages = member->messages();
+    }
+
+    UQQMessageHistory *history = qobject_cast<UQQMessageHistory *>(messages);
+    if (history)
+        history->setState(msgId, state);
+}
+
+/*
+ * Starts the poll loop, a poll2 request is kept outstanding until
+ * stopPoll(), logout or a kick. With overlap there are two of them.
+ */
+void UQQClient::poll(bool overlap) {
+    m_pollEngine->start(overlap);
+}
+
+void UQQClient::stopPoll() {
+    m_pollEngine->stop();
+}
+
+// the scheduler reports what became of each request, counted by its action
+void UQQClient::onRequestSent(const QNetworkRequest &request) {
+    m_metrics.sent(request.attribute(QNetworkRequest::User).toInt());
+}
+
+void UQQClient::onRequestCoalesced(const QNetworkRequest &request) {
+    m_metrics.coalesced(request.attribute(QNetworkRequest::User).toInt());
+}
+
+void UQQClient::onRequestDropped(const QNetworkRequest &request) {
+    m_metrics.dropped(request.attribute(QNetworkRequest::User).toInt());
+}
+
+QVariantMap UQQClient::pollMetrics() const {
+    return m_pollEngine->metrics();
+}
+
+/*
+ * Request counters and latencies per action, reply parse times, the poll
+ * engine, the number of model objects and the bytes of held messages.
+ */
+QVariantMap UQQClient::metrics() const {
+    const QMetaObject &mo = staticMetaObject;
+    QVariantMap m = m_metrics.toMap(mo.enumerator(mo.indexOfEnumerator("Action")));
+
+    QVariantMap models;
+    if (m_contact) {
+        models.insert("buddies", m_contact->members().size());
+        models.insert("categories", m_contact->categories().size());
+    }
+    if (m_group) {
+        int members = 0;
+        foreach (UQQCategory *group, m_group->groups())
+            members += group->members().size();
+        models.insert("groups", m_group->groups().size());
+        models.insert("groupMembers", members);
+    }
+    m.insert("models", models);
+    m.insert("messageBytes", UQQMessageHistory::totalBytes());
+    m.insert("poll", m_pollEngine->metrics());
+    return m;
+}
 
-    TEST(onMessageSended(gid, dstUin, readFile("test/retok.txt")));
-    post(SendSessionMessageAction, url, QUrl::toPercentEncoding(p, "=&"), attributes);
+/*
+ * Appends metrics() as a JSON line to fileName every interval seconds
+ * (60 if not given), an empty fileName stops it.
+ */
+void UQQClient::setMetricsDump(const QString &fileName, int interval) {
+    m_metricsFile = fileName;
+    if (fileName.isEmpty()) {
+        m_metricsTimer->stop();
+        return;
+    }
+    m_metricsTimer->start((interval > 0 ? interval : 60) * 1000);
+}
 
+void UQQClient::dumpMetrics() {
+    QFile file(m_metricsFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        uqqWarning(General) << "Error: open metrics file" << m_metricsFile;
+        return;
+    }
+    QVariantMap m = metrics();
+    m.insert("time", QDateTime::currentDateTime().toString(Qt::ISODate));
+    file.write(QJsonDocument(QJsonObject::fromVariantMap(m)).toJson(QJsonDocument::Compact));
+    file.write("\n");
 }
 
-void UQQClient::poll() {
-    qDebug() << QTime::currentTime().toString("hh:mm:ss") << "begin poll...";
+void UQQClient::sendPoll() {
+    uqqDebug(Poll) << "begin poll...";
 
     QVariantMap param;
-    QUrl url("http://d.web2.qq.com/channel/poll2");
+    QUrl url = endpoint("d.web2.qq.com", "/channel/poll2");
 
     param.insert("clientid", getLoginInfo("clientid"));
     param.insert("psessionid", getLoginInfo("psessionid"));
@@ -1222,53 +1611,113 @@ void UQQClient::poll() {
     post(PollMessageAction, url, QUrl::toPercentEncoding(p, "=&"));
 }
 
-void UQQClient::parsePoll(const QByteArray &data) {
-    QString pollType;
-    QVariantMap m;
-    int retCode = NoError;
-    const QVariantList &result = getResponseResult(data, &retCode).toList();
+int UQQClient::parsePoll(const QByteArray &data) {
+    QByteArray result;
+    int retCode = DefaultError;
+    UQQJsonReader reader(data);
+
+    if (reader.enterObject()) {
+        while (reader.nextName()) {
+            if (reader.nameIs("retcode"))
+                retCode = reader.readInt();
+            else if (reader.nameIs("result"))
+                result = reader.readRaw();  // the retcode may follow the result
+            else
+                reader.skip();
+        }
+    }
 
     if (retCode == NoError) {
-        for (int i = 0; i < result.size(); i++) {
-            m = result.at(i).toMap();
-            pollType = m.value("poll_type").toString();
-            m = m.value("value").toMap();
-            if (pollType == "buddies_status_change") {
-                pollStatusChanged(m);
-            } else if (pollType == "message") {
-                pollMemberMessage(m);
-            } else if (pollType == "kick_message") {
-                //qDebug() << data;
-                pollKickMessage(m);
-            } else if (pollType == "group_message") {
-                pollGroupMessage(m);
-            } else if (pollType == "sess_message") {
-                //qDebug() << data;
-                pollSessionMessage(m);
-            } else if (pollType == "input_notify") {
-                //qDebug() << data;
-                pollInputNotify(m);
-            } else {
-                qWarning() << "Unknown poll type:" << pollType;
-                qDebug() << data;
-            }
+        UQQJsonReader events(result);
+        if (events.enterArray()) {
+            while (events.nextElement())
+                parsePollEvent(events);
         }
+        if (events.hasError())
+            uqqWarning(Poll) << "parsePoll:" << data;
     } else if (retCode == PollNormalReturn) {
-        //qDebug() << "poll normal return";
+        //uqqDebug(Poll) << "poll normal return";
     } else if (retCode == PollOfflineError) {
-        qDebug() << "Poll error:" << PollOfflineError;
+        uqqDebug(Poll) << "Poll error:" << PollOfflineError;
     } else {
-        qWarning() << "parsePoll:" << data;
+        uqqWarning(Poll) << "parsePoll:" << data;
     }
-    qDebug() << QTime::currentTime().toString("hh:mm:ss") << "poll done.";
+    uqqDebug(Poll) << "poll done.";
     emit pollReceived();
+    return retCode;
+}
+
+void UQQClient::onPollReply(const QByteArray &data) {
+    switch (parsePoll(data)) {
+    case NoError:
+    case PollNormalReturn:
+        m_pollEngine->finished(UQQPollEngine::Succeeded);
+        break;
+    case PollOfflineError:
+        m_pollEngine->finished(UQQPollEngine::Offline);
+        break;
+    default:    // unknown retcodes are retried like network errors
+        m_pollEngine->finished(UQQPollEngine::Failed);
+    }
 }
 
-void UQQClient::pollStatusChanged(const QVariantMap &m) {
+/*
+ * {"poll_type":"message","value":{...}}
+ */
+void UQQClient::parsePollEvent(UQQJsonReader &reader) {
+    QByteArray pollType;
+    QByteArray value;
+    UQQPollMessage message;
+
+    if (!reader.enterObject()) {
+        reader.skip();
+        return;
+    }
+    while (reader.nextName()) {
+        if (reader.nameIs("poll_type"))
+            pollType = reader.readRawString();
+        else if (reader.nameIs("value"))
+            value = reader.readRaw();   // the poll_type may follow the value
+        else
+            reader.skip();
+    }
+
+    QHash<QByteArray, PollHandler>::ConstIterator handler = m_pollHandlers.constFind(pollType);
+    if (handler == m_pollHandlers.constEnd()) {
+        uqqWarning(Poll) << "Unknown poll type:" << pollType;
+        uqqDebug(Poll) << value;
+        return;
+    }
+
+    UQQJsonReader m(value);
+    if (handler->message) {
+        if (readPollMessage(m, &message))
+            (this->*handler->message)(message);
+    } else {
+        (this->*handler->event)(m);
+    }
+}
+
+// {"uin":1234567,"status":"online","client_type":1}
+void UQQClient::pollStatusChanged(UQQJsonReader &reader) {
     UQQMember *member;
-    QString uin = m.value("uin").toString();
-    int status = UQQMember::statusIndex(m.value("status").toString());
-    int clientType = m.value("client_type").toInt();
+    UQQUin uin = 0;
+    QString statusName;
+    int clientType = 0;
+
+    if (!reader.enterObject()) return;
+    while (reader.nextName()) {
+        if (reader.nameIs("uin"))
+            uin = reader.readUInt();
+        else if (reader.nameIs("status"))
+            statusName = reader.readString();
+        else if (reader.nameIs("client_type"))
+            clientType = reader.readInt();
+        else
+            reader.skip();
+    }
+    if (uin == 0) return;
+    int status = UQQMember::statusIndex(statusName);
 
     member = this->member(UQQCategory::IllegalCategoryId, uin);
     if (!q_check_ptr(member)) return;
@@ -1278,142 +1727,143 @@ void UQQClient::pollStatusChanged(const QVariantMap &m) {
         m_contact->setBuddyStatus(uin, status, clientType);
         if (oldStatus != status) {
             if (oldStatus == UQQMember::OfflineStatus)
-                emit buddyOnline(uin);
-            emit buddyStatusChanged(member->gid(), uin);
+                emit buddyOnline(member->uin());
+            emit buddyStatusChanged(member->gid(), member->uin());
         }
     }
 }
 
-void UQQClient::pollInputNotify(const QVariantMap &m) {
-    QString fromUin = m.value("from_uin").toString();
-    UQQMember *member = this->member(UQQCategory::IllegalCategoryId, fromUin);
+void UQQClient::pollInputNotify(UQQJsonReader &reader) {
+    UQQUin fromUin = 0;
+
+    if (!reader.enterObject()) return;
+    while (reader.nextName()) {
+        if (reader.nameIs("from_uin"))
+            fromUin = reader.readUInt();
+        else
+            reader.skip();
+    }
+    if (fromUin == 0) return;
 
+    UQQMember *member = this->member(UQQCategory::IllegalCategoryId, fromUin);
     if (q_check_ptr(member))
         member->setInputNotify(true);
 }
 
-UQQMessage *UQQClient::parseMessage(QString fromUin, const QVariantMap &m) {
-    QVariantList contentList;
-    QVariantList fontList;
-    QString content;
-    UQQMessage *message = new UQQMessage();
-
-    message->setSrc(fromUin);
-    message->setDst(m.value("to_uin").toString());
-    message->setId(m.value("msg_id").toInt());
-    message->setId2(m.value("msg_id2").toInt());
-    message->setType(m.value("msg_type").toInt());
-    message->setReplyIP(m.value("reply_ip").toUInt());
-
-    QDateTime datetime =
-            QDateTime::fromMSecsSinceEpoch(m.value("time").toLongLong() * 1000); // s -> ms
-    message->setTime(datetime);
-
-    /*
-     * "content":[["font",{"size":10,"color":"000000","style":[0,0,0],"name":"\u5B8B\u4F53"}],
-     * "hello",["face",14],"world "]
-     */
-    contentList = m.value("content").toList();
-    if (contentList.first().type() == QVariant::List) {
-        fontList = contentList.takeFirst().toList();
-
-    } else {
-        qWarning() << "font list not found!";
+bool UQQClient::readPollMessage(UQQJsonReader &reader, UQQPollMessage *m) {
+    if (!reader.enterObject()) return false;
+
+    while (reader.nextName()) {
+        if (reader.nameIs("from_uin"))
+            m->fromUin = reader.readUInt();
+        else if (reader.nameIs("to_uin"))
+            m->toUin = reader.readUInt();
+        else if (reader.nameIs("send_uin"))
+            m->sendUin = reader.readUInt();
+        else if (reader.nameIs("group_code"))
+            m->groupCode = reader.readUInt();
+        else if (reader.nameIs("id"))
+            m->id = reader.readUInt();
+        else if (reader.nameIs("msg_id"))
+            m->msgId = reader.readInt();
+        else if (reader.nameIs("msg_id2"))
+            m->msgId2 = reader.readInt();
+        else if (reader.nameIs("msg_type"))
+            m->msgType = reader.readInt();
+        else if (reader.nameIs("reply_ip"))
+            m->replyIP = reader.readUInt();
+        else if (reader.nameIs("time"))
+            m->time = reader.readInt();
+        else if (reader.nameIs("content"))
+            m->content = reader.readRaw();
+        else
+            reader.skip();
     }
+    return !reader.hasError();
+}
 
-    foreach(QVariant value, contentList) {
-        if (value.type() == QVariant::String) { // common text message
-            content.append(value.toString());
-        } else if (value.type() == QVariant::List) {    // face number
-            const QVariantList &face = value.toList(); // face in the content just like: ':face1'
-            content.append("[");
-            foreach(QVariant v, face) {
-                content.append(v.toString());
-            }
-            content.append("]");
-        } else {
-            qWarning() << "unknown message type:" << value.typeName();
-        }
-    }
+UQQMessage UQQClient::parseMessage(UQQUin fromUin, const UQQPollMessage &m) {
+    UQQMessage message;
+
+    message.setSrc(fromUin);
+    message.setDst(m.toUin);
+    message.setId(m.msgId);
+    message.setId2(m.msgId2);
+    message.setType(m.msgType);
+    message.setTimestamp(m.time);
 
-    message->setContent(content);
+    UQQContentCodec::decode(m.content, &message);
 
     return message;
 }
 
-void UQQClient::pollMemberMessage(const QVariantMap &m) {
-    QString src = m.value("from_uin").toString();
+void UQQClient::pollMemberMessage(const UQQPollMessage &m) {
+    UQQUin src = m.fromUin;
     UQQMember *member = this->member(UQQCategory::IllegalCategoryId, src);
     if (!q_check_ptr(member)) return;
 
-    UQQMessage *message = parseMessage(src, m);
-    message->setParent(member);
-    message->setName(member->markname() == "" ? member->nickname() : member->nickname());
+    UQQMessage message = parseMessage(src, m);
+    message.setName(member->markname() == "" ? member->nickname() : member->markname());
     member->addMessage(message);
     member->setInputNotify(false);
 
     emit memberMessageReceived(member->gid());
 }
 
-void UQQClient::pollGroupMessage(const QVariantMap &m) {
-    quint64 gcode = m.value("group_code").toULongLong();
-    UQQCategory *group = m_group->getGroupByCode(gcode);
+void UQQClient::pollGroupMessage(const UQQPollMessage &m) {
+    UQQCategory *group = m_group->getGroupByCode(m.groupCode);
     if (!q_check_ptr(group)) return;
 
-    QString fromUin = m.value("send_uin").toString();
-    UQQMessage *message = parseMessage(fromUin, m);
-    message->setParent(group);
-    group->addMessage(message);
+    group->addMessage(parseMessage(m.sendUin, m));
 
     if (group->messageMask() == UQQCategory::MessageNotify)
         emit groupMessageReceived(group->id());
 }
 
-void UQQClient::pollSessionMessage(const QVariantMap &m) {
-    QString fromUin = m.value("from_uin").toString();
-    quint64 gid = m.value("id").toULongLong();
+void UQQClient::pollSessionMessage(const UQQPollMessage &m) {
+    UQQUin fromUin = m.fromUin;
+    quint64 gid = m.id;
     UQQMember *member = Q_NULLPTR;
 
-    UQQMessage *message = parseMessage(fromUin, m);
+    UQQMessage message = parseMessage(fromUin, m);
 
     if ((member = this->member(gid, fromUin)) != Q_NULLPTR) {
-        message->setParent(member);
-        message->setName(member->card() == "" ? (member->markname() == "" ? member->nickname() : member->nickname()) : member->card());
+        message.setName(member->card() == "" ? (member->markname() == "" ? member->nickname() : member->markname()) : member->card());
         member->addMessage(message);
         //emit sessionMessageReceived(group->id());
     } else {
         m_contact->addSessMessage(message);
-        getStrangerInfo(gid, fromUin);
+        getStrangerInfo(gid, QString::number(fromUin));
         emit memberMessageReceived(UQQCategory::StrangerCategoryId);
     }
 }
 
 // {"way":"poll","show_reason":1,"reason":"reason msg"}
-void UQQClient::pollKickMessage(const QVariantMap &m) {
-    qDebug() << "pollKickMessage";
-    //bool showReason = m.value("show_reason").toBool();
+void UQQClient::pollKickMessage(UQQJsonReader &reader) {
+    QString reason;
+    uqqDebug(Poll) << "pollKickMessage";
+
+    if (reader.enterObject()) {
+        while (reader.nextName()) {
+            if (reader.nameIs("reason"))
+                reason = reader.readString();
+            else
+                reader.skip();
+        }
+    }
     //if (showReason)
-    //    addLoginInfo("errMsg", m.value("reason").toString());
+    //    addLoginInfo("errMsg", reason);
 
-    emit kicked(m.value("reason").toString());
+    m_pollEngine->stop();
+    emit kicked(reason);
 }
 
-QList<QObject *> UQQClient::getContactList() {
-    QList<QObject *> categories;
-    QList<UQQCategory *> &list = m_contact->categories();
-    for (int i = 0; i < list.size(); i++) {
-        categories.append(list.at(i));
-    }
-    return categories;
+QObject *UQQClient::getContactList() {
+    return m_contact->model();
 }
 
-QList<QObject *> UQQClient::getGroupList() {
-    QList<QObject *> groups;
-    QList<UQQCategory *> &list = m_group->groups();
-    for (int i = 0; i < list.size(); i++) {
-        groups.append(list.at(i));
-    }
-    return groups;
+QObject *UQQClient::getGroupList() {
+    return m_group->model();
 }
 
 QList<QObject *> UQQClient::getMember(QString uin) {
@@ -1426,26 +1876,16 @@ QList<QObject *> UQQClient::getMember(QString uin) {
     return members;
 }
 
-QList<QObject *> UQQClient::getCategoryMembers(quint64 catid) {
-    //qDebug() << "get category members...";
-    QList<QObject *> list;
-    const QList<UQQMember *> &members = m_contact->membersInCategory(catid, true);
-
-    for (int i = 0; i < members.size(); i++) {
-        list.append(members.at(i));
-    }
-    //qDebug() << "category members:" << list.size();
-    return list;
+QObject *UQQClient::getCategoryMembers(quint64 catid) {
+    UQQCategory *category = m_contact->getCategory(catid);
+    if (!category) return Q_NULLPTR;
+    return category->memberModel();
 }
 
-QList<QObject *> UQQClient::getGroupMembers(quint64 gid) {
-    QList<QObject *> list;
-    const QList<UQQMember *> &members = m_group->memberInGroup(gid, true);
-
-    for (int i = 0; i < members.size(); i++) {
-        list.append(members.at(i));
-    }
-    return list;
+QObject *UQQClient::getGroupMembers(quint64 gid) {
+    UQQCategory *group = m_group->getGroupById(gid);
+    if (!group) return Q_NULLPTR;
+    return group->memberModel();
 }
 
 QString UQQClient::imageFormat(const QByteArray &data) {
@@ -1454,7 +1894,7 @@ QString UQQClient::imageFormat(const QByteArray &data) {
     QByteArray bmp = QByteArray("424d");
     QByteArray gif = QByteArray("4749463839");
     QByteArray header = data.left(8).toHex();
-    //qDebug() << header.toHex();
+    //uqqDebug(General) << header.toHex();
 
     if (header.startsWith(png)) {
         return ".png";
@@ -1465,7 +1905,7 @@ QString UQQClient::imageFormat(const QByteArray &data) {
     } else if (header.startsWith(gif)) {
         return ".gif";
     } else {
-        qWarning() << "Unknown image format, prefix:" << header;
+        uqqWarning(General) << "Unknown image format, prefix:" << header;
         return "";
     }
 }
@@ -1496,7 +1936,7 @@ QString UQQClient::getCookie(const QString &name, QUrl url) const {
 
     QList<QNetworkCookie> cookies = m_manager->cookieJar()->cookiesForUrl(url);
     for (int i = 0; i < cookies.size(); i++) {
-        //qDebug() << "name:" << cookies.at(i).name() << ", value:" << cookies.at(i).value();
+        //uqqDebug(Net) << "name:" << cookies.at(i).name() << ", value:" << cookies.at(i).value();
         if (cookies.at(i).name() == name) {
             return cookies.at(i).value();
         }
@@ -1514,32 +1954,56 @@ void UQQClient::addConfig(const QString &key, const QVariant &value) {
 QString UQQClient::getClientId() {
     // JS:  = String(k.random(0, 99)) + String((new Date()).getTime() % 1000000)
     qint64 ms = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch();
-    qsrand(ms);
-    int rand = qrand() % 100;
+    int rand = m_random.bounded(100);
     QString id = QString::number(rand) + QString::number(ms % 1000000);
-    //qDebug() << "clientId:" << id;
+    //uqqDebug(General) << "clientId:" << id;
     return id;
 }
 
-int     UQQClient::getRandomInt(int max) {
-    qint64 ms = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch();
-    qsrand(ms);
-    return qrand() % max;
-}
-
 QString UQQClient::getRandom() {
-    qint64 ms = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch();
-    qsrand(ms);
-    qreal r = qrand() / (qreal)ms;
-    QString rs = QString::number(r, 'g', 14);
-    //qDebug() << "random:" << rs;
+    QString rs = QString::number(m_random.real(), 'g', 14);
+    //uqqDebug(General) << "random:" << rs;
     return rs;
 }
 
+/*
+ * msg_ids only have to differ within a session, they count up from a
+ * random start and wrap inside the range the web client uses.
+ */
+int UQQClient::nextMsgId() {
+    int id = m_nextMsgId++;
+    if (m_nextMsgId >= MinMsgId + MsgIdRange)
+        m_nextMsgId = MinMsgId;
+    return id;
+}
+
+/*
+ * All requests go to base instead of the QQ hosts when it is set, e.g.
+ * "http://127.0.0.1:8080" for tools/mockserver.py. The paths of the hosts
+ * do not overlap, so the path alone tells the endpoint.
+ */
+void UQQClient::setEndpoint(const QString &base) {
+    m_endpointBase = QUrl(base);
+    if (!base.isEmpty())
+        uqqDebug(General) << "endpoint:" << m_endpointBase.toString();
+}
+
+QUrl UQQClient::endpoint(const QString &host, const QString &path) const {
+    if (m_endpointBase.isEmpty())
+        return QUrl("http://" + host + path);
+
+    QUrl url(m_endpointBase);
+    QString prefix = url.path();
+    if (prefix.endsWith('/'))
+        prefix.chop(1);
+    url.setPath(prefix + path);
+    return url;
+}
+
 QString UQQClient::getTimestamp() {
     qint64 ms = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch();
     QString ts = QString::number(ms);
-    //qDebug() << "timestamp:" << ts;
+    //uqqDebug(General) << "timestamp:" << ts;
     return ts;
 }
 
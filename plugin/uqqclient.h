@@ -4,14 +4,48 @@
 #include <QtNetwork>
 #include "uqqcontact.h"
 #include "uqqgroup.h"
+#include "uqqjsonreader.h"
+#include "uqqfacecache.h"
+#include "uqqrequestscheduler.h"
+#include "uqqdemandqueue.h"
+#include "uqqpollengine.h"
+#include "uqqrequestcontext.h"
+#include "uqqcontentcodec.h"
+#include "uqqsendqueue.h"
+#include "uqqrandom.h"
+#include "uqqnetworkmanager.h"
+#include "uqqmetrics.h"
 
 #define TYPE_SEND -1
 
 typedef QMap<QByteArray, QByteArray> RequestHeaderMap;
 
+/*
+ * The fields of a poll2 message/group_message/sess_message value,
+ * the content array is kept undecoded until the message is built.
+ */
+struct UQQPollMessage {
+    UQQPollMessage()
+        : fromUin(0), toUin(0), sendUin(0), groupCode(0), id(0),
+          msgId(0), msgId2(0), msgType(0), replyIP(0), time(0) {}
+
+    UQQUin fromUin;
+    UQQUin toUin;
+    UQQUin sendUin;
+    quint64 groupCode;
+    quint64 id;
+    int msgId;
+    int msgId2;
+    int msgType;
+    quint32 replyIP;
+    qint64 time;
+    QByteArray content;
+};
+
 class UQQClient : public QObject {
 
     Q_OBJECT
+    Q_ENUMS(Action)
 public:
     enum Action {
         // Login phase actions
@@ -51,6 +85,23 @@ public:
         DefaultError = 10000
     };
 
+    enum StartupStage {
+        ContactStage = 0x1,
+        OnlineStage = 0x2,
+        GroupStage = 0x4,
+        AllStages = ContactStage | OnlineStage | GroupStage
+    };
+
+    enum {
+        SnapshotMagic = 0x55515153,     // "UQQS"
+        SnapshotVersion = 2     // 2: uins stored as numbers
+    };
+
+    enum {
+        MinMsgId = 1000000,
+        MsgIdRange = 9000000    // ids stay below 10000000 like before
+    };
+
     //Q_PROPERTY(QVariantMap userInfo READ userInfo NOTIFY userInfoChanged)
 
     explicit UQQClient(QObject *parent = 0);
@@ -70,13 +121,18 @@ public:
     Q_INVOKABLE void getSimpleInfo(quint64 gid, QString uin);
     Q_INVOKABLE void getMemberDetail(quint64 gid, QString uin);
     Q_INVOKABLE void loadContact();
-    Q_INVOKABLE QList<QObject *> getContactList();
-    Q_INVOKABLE QList<QObject *> getGroupList();
-    Q_INVOKABLE QList<QObject *> getCategoryMembers(quint64 catid);
-    Q_INVOKABLE QList<QObject *> getGroupMembers(quint64 gid);
+    Q_INVOKABLE QObject *getContactList();
+    Q_INVOKABLE QObject *getGroupList();
+    Q_INVOKABLE QObject *getCategoryMembers(quint64 catid);
+    Q_INVOKABLE QObject *getGroupMembers(quint64 gid);
     Q_INVOKABLE QList<QObject *> getMember(QString uin);
     Q_INVOKABLE void getOnlineBuddies();
-    Q_INVOKABLE void poll();
+    Q_INVOKABLE void poll(bool overlap = false);
+    Q_INVOKABLE void stopPoll();
+    Q_INVOKABLE QVariantMap pollMetrics() const;
+    Q_INVOKABLE QVariantMap metrics() const;
+    Q_INVOKABLE void setMetricsDump(const QString &fileName, int interval = 0);
+    Q_INVOKABLE void setEndpoint(const QString &base);
     Q_INVOKABLE void sendBuddyMessage(QString dstUin, QString content);
     Q_INVOKABLE void sendGroupMessage(quint64 gid, QString content);
     Q_INVOKABLE void changeStatus(QString status);
@@ -91,15 +147,38 @@ private:
     QVariant getConfig(const QString &key) const;
     void addConfig(const QString &key, const QVariant &value);
 
+    typedef void (UQQClient::*ReplyHandler)(const UQQRequestContext &context,
+                                            QNetworkReply *reply, const QByteArray &data);
+    typedef void (UQQClient::*PollEventHandler)(UQQJsonReader &reader);
+    typedef void (UQQClient::*PollMessageHandler)(const UQQPollMessage &m);
+    struct PollHandler {
+        PollEventHandler event;         // reads the value itself
+        PollMessageHandler message;     // gets the value read by readPollMessage()
+    };
+
+    void initHandlers();
+    void registerReply(Action action, ReplyHandler handler);
+    void registerPollEvent(const QByteArray &type, PollEventHandler handler);
+    void registerPollMessage(const QByteArray &type, PollMessageHandler handler);
+    template <void (UQQClient::*parse)(const QByteArray &)>
+    void replyData(const UQQRequestContext &context, QNetworkReply *reply, const QByteArray &data);
+    template <void (UQQClient::*parse)(const UQQRequestContext &, const QByteArray &)>
+    void replyContext(const UQQRequestContext &context, QNetworkReply *reply, const QByteArray &data);
+
     void get(Action action, QUrl url,
-             const QVariantList &attributes = QVariantList(),
+             const UQQRequestContext &context = UQQRequestContext(),
              const RequestHeaderMap &headers = RequestHeaderMap());
     void post(Action action, QUrl url,
               const QByteArray &data = QByteArray(),
-              const QVariantList &attributes = QVariantList(),
+              const UQQRequestContext &context = UQQRequestContext(),
               const RequestHeaderMap &headers = RequestHeaderMap());
+    static UQQRequestScheduler::Priority requestPriority(Action action);
+    static QByteArray requestKey(Action action, const UQQRequestContext &context);
+    void requestFailed(Action action, const UQQRequestContext &context);
+    void handleReply(Action action, const UQQRequestContext &context,
+                     QNetworkReply *reply, const QByteArray &data);
     QVariant getResponseResult(const QByteArray &data, int *retCode = Q_NULLPTR);
-    void verifyCode(const QString &data);
+    void verifyCode(const QByteArray &data);
     void getCaptcha();
     void saveCaptcha(const QByteArray &data);
     void verifyLogin(const QByteArray &data);
@@ -109,57 +188,67 @@ private:
     void getMemberFace(const QString &uin);
     void getGroupMemberFace(quint64 gid, const QString &uin);
     void getLongNick(quint64 gid, const QString &uin);
-    void parseLongNick(quint64 gid, const QString &uin, const QByteArray &data);
+    void parseLongNick(const UQQRequestContext &context, const QByteArray &data);
     void getMemberLevel(const QString &uin);
-    void parseMemberLevel(const QString &uin, const QByteArray &data);
+    void parseMemberLevel(const UQQRequestContext &context, const QByteArray &data);
     void getMemberInfo(const QString &uin);
-    void parseMemberInfo(const QString &uin, const QByteArray &data);
+    void parseMemberInfo(const UQQRequestContext &context, const QByteArray &data);
     void getStrangerInfo(quint64 gid, const QString &uin);
-    void parseStrangerInfo(quint64 gid, const QString &uin, const QByteArray &data);
+    void parseStrangerInfo(const UQQRequestContext &context, const QByteArray &data);
     void getUserFace();
     void getMemberAccount(quint64 gid, const QString &uin);
     void getGroupAccount(const QString &uin);
     void getAccount(quint64 gid, const QString &uin, Action action);
-    void parseAccount(quint64 gid, const QString &uin, const QByteArray &data, Action action);
+    void parseMemberAccount(const UQQRequestContext &context, const QByteArray &data);
+    void parseGroupAccount(const UQQRequestContext &context, const QByteArray &data);
     void getFace(quint64 gid, const QString &uin, int cache = 0, int type = 1);
-    void saveFace(quint64 gid, const QString &uin, const QByteArray &data);
+    void saveFace(const UQQRequestContext &context, QNetworkReply *reply, const QByteArray &data);
     void parseContact(const QByteArray &data);
     void parseOnlineBuddies(const QByteArray &data);
 
     void loadGroups();
     void parseGroups(const QByteArray &data);
-    void parseGroupInfo(quint64 gid, const QByteArray &data);
+    void parseGroupInfo(const UQQRequestContext &context, const QByteArray &data);
     void setMemberDetail(UQQMember *member, const QVariantMap &m);
+    void demandDetail(quint64 gid, UQQMember *member, UQQMemberDetail::Part part, bool urgent);
+    UQQMemberDetail *ensureDetail(UQQMember *member);
 
-    QString makeContent(const QString &content);
-    QString buddyMessageData(QString dstUin, QString content);
-    QString groupMessageData(QString groupUin, QString content);
-    QString sessionMessageData(quint64 gid, const QString &dstUin, const QString &content);
-    void onMessageSended(quint64 gid, const QString &uin, const QByteArray &data);
-    void parseChangeStatus(const QString &status, const QByteArray &data);
-    void parseGroupSig(quint64 gid, const QString &dstUin, const QByteArray &data);
-    void parseGroupMask(quint64 gid, int mask, const QByteArray &data);
+    QString buddyMessageData(QString dstUin, QString content, int msgId);
+    QString groupMessageData(QString groupUin, QString content, int msgId);
+    QString sessionMessageData(quint64 gid, const QString &dstUin, const QString &content, int msgId);
+    void onMessageSended(const UQQRequestContext &context, const QByteArray &data);
+    void parseChangeStatus(const UQQRequestContext &context, const QByteArray &data);
+    void parseGroupSig(const UQQRequestContext &context, const QByteArray &data);
+    void parseGroupMask(const UQQRequestContext &context, const QByteArray &data);
 
     int parseParamList(const QString &data, QStringList &paramList);
     QString getCookie(const QString &name, QUrl url) const;
 
+    UQQMember *member(quint64 gid, UQQUin uin);
     UQQMember *member(quint64 gid, const QString &uin);
     QString getClientId();
     QString getRandom();
-    int getRandomInt(int max);
+    int nextMsgId();
+    QUrl endpoint(const QString &host, const QString &path) const;
     QString getTimestamp();
     QString imageFormat(const QByteArray &data);
 
     void onLoginSuccess(const QString &uin, const QString &status);
+    void startLoading();
+    void finishStage(StartupStage stage);
+    bool loadSnapshot();
 
-    void parsePoll(const QByteArray &data);
-    void pollStatusChanged(const QVariantMap &m);
-    void pollInputNotify(const QVariantMap &m);
-    UQQMessage *parseMessage(QString fromUin, const QVariantMap &m);
-    void pollMemberMessage(const QVariantMap &m);
-    void pollGroupMessage(const QVariantMap &m);
-    void pollSessionMessage(const QVariantMap &m);
-    void pollKickMessage(const QVariantMap &m);
+    int parsePoll(const QByteArray &data);
+    void onPollReply(const QByteArray &data);
+    void parsePollEvent(UQQJsonReader &reader);
+    bool readPollMessage(UQQJsonReader &reader, UQQPollMessage *m);
+    void pollStatusChanged(UQQJsonReader &reader);
+    void pollInputNotify(UQQJsonReader &reader);
+    UQQMessage parseMessage(UQQUin fromUin, const UQQPollMessage &m);
+    void pollMemberMessage(const UQQPollMessage &m);
+    void pollGroupMessage(const UQQPollMessage &m);
+    void pollSessionMessage(const UQQPollMessage &m);
+    void pollKickMessage(UQQJsonReader &reader);
 
     void parseLogout(const QByteArray &data);
 
@@ -172,6 +261,8 @@ signals:
     void errorChanged(int errCode);
     void captchaChanged(bool needed);
     void loginSuccess();
+    void contactReady();
+    void groupListReady();
     void ready();
     void groupReady(quint64 gid);
     void onlineStatusChanged();
@@ -187,10 +278,42 @@ signals:
 public slots:
     void onFinished(QNetworkReply *reply);
 
+private slots:
+    void saveSnapshot();
+    void onDemand(int kind, quint64 gid, const QString &uin);
+    void sendPoll();
+    void renewSession();
+    void dumpMetrics();
+    void onRequestSent(const QNetworkRequest &request);
+    void onRequestCoalesced(const QNetworkRequest &request);
+    void onRequestDropped(const QNetworkRequest &request);
+    void sendQueued(int kind, quint64 gid, const QString &uin, const QString &content, int msgId);
+    void onSendStateChanged(int kind, quint64 gid, const QString &uin, int msgId, int state);
+
 private:
     QVariantMap m_loginInfo;
     QVariantMap m_config;
     QNetworkAccessManager *m_manager;
+    UQQRequestScheduler *m_scheduler;
+    int m_startupStages;
+    QVariantList m_pendingOnline;
+    bool m_snapshotLoaded;
+    QTimer *m_snapshotTimer;
+    UQQFaceCache m_faceCache;
+    UQQContentCodec m_contentCodec;
+    UQQDemandQueue *m_demands;
+    UQQPollEngine *m_pollEngine;
+    UQQSendQueue *m_sendQueue;
+    bool m_renewing;
+    QUrl m_endpointBase;    // empty: the QQ hosts
+    UQQMetrics m_metrics;
+    QTimer *m_metricsTimer;
+    QString m_metricsFile;
+    UQQRandom m_random;
+    int m_nextMsgId;
+
+    QHash<int, ReplyHandler> m_replyHandlers;          // action -> handler
+    QHash<QByteArray, PollHandler> m_pollHandlers;     // poll_type -> handler
 
     UQQContact *m_contact;
     UQQGroup *m_group;
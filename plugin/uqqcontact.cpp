@@ -1,9 +1,11 @@
 #include "uqqcontact.h"
+#include "uqqlog.h"
 
 
 UQQContact::UQQContact(QObject *parent) :
     QObject(parent)
 {
+    m_model = new UQQCategoryModel(m_categories, this);
 }
 
 UQQContact::~UQQContact() {
@@ -19,101 +21,189 @@ UQQContact::~UQQContact() {
  *       }
 */
 void UQQContact::setContactData(const QVariantMap &map) {
-    setCategories(map.value("categories").toList());
+    QList<UQQCategory *> stale = setCategories(map.value("categories").toList());
     setMembers(map.value("friends").toList());
     setMarknames(map.value("marknames").toList());
     setVipInfo(map.value("vipinfo").toList());
     setNickname(map.value("info").toList());
+
+    foreach (UQQCategory *category, stale) {
+        removeCategory(category);
+    }
 }
 
 void UQQContact::addMember(UQQMember *member) {
     if (member) {
-        Q_ASSERT(!member->uin().isEmpty());
-        m_members.insert(member->uin(), member);
+        Q_ASSERT(member->uinKey() != 0);
+        m_members.insert(member->uinKey(), member);
         addMemberToCategory(member->gid(), member);
     }
 }
 
+/*
+ * The members may already be there from the snapshot, they are updated in
+ * place and friends missing from the list are dropped from their category.
+ */
 void UQQContact::setMembers(const QVariantList &list) {
     QVariantMap m;
-    qDebug() << "set members...";
+    QSet<UQQUin> uins;
+    UQQMember *member;
+    uqqDebug(Contact) << "set members...";
     for (int i = 0; i < list.size(); i++) {
         m = list.at(i).toMap();
-        addMember(new UQQMember(m.value("categories").toULongLong(), m.value("uin").toString(), this));
+        UQQUin uin = m.value("uin").toULongLong();
+        quint64 gid = m.value("categories").toULongLong();
+        uins.insert(uin);
+
+        if ((member = this->member(uin)) == Q_NULLPTR) {
+            addMember(new UQQMember(gid, QString::number(uin), this));
+        } else if (member->gid() != gid) {
+            moveMember(member, gid);
+        }
+    }
+
+    QList<UQQMember *> stale;
+    foreach (member, m_members) {
+        if (!uins.contains(member->uinKey()) && isFriendCategory(member->gid()))
+            stale.append(member);
+    }
+    foreach (member, stale) {   // groups may still refer to them, so no delete
+        getCategory(member->gid())->removeMember(member);
+        m_members.remove(member->uinKey());
+        member->setIsFriend(false);
     }
-    qDebug() << "set members done, total members:" << list.size();
+    uqqDebug(Contact) << "set members done, total members:" << list.size() << "removed:" << stale.size();
+}
+
+void UQQContact::moveMember(UQQMember *member, quint64 gid) {
+    UQQCategory *cat = memberCategory(member);
+    if (cat)
+        cat->removeMember(member);
+    member->setGid(gid);
+    addMemberToCategory(gid, member);
+}
+
+bool UQQContact::isFriendCategory(quint64 id) {
+    return id != UQQCategory::StrangerCategoryId && getCategory(id) != Q_NULLPTR;
 }
 
 void UQQContact::setMarknames(const QVariantList &list) {
     QVariantMap m;
     UQQMember *member;
-    qDebug() << "set member marknames...";
+    uqqDebug(Contact) << "set member marknames...";
     for (int i = 0; i < list.size(); i++) {
         m = list.at(i).toMap();
-        member = this->member(m.value("uin").toString());
+        member = this->member(m.value("uin").toULongLong());
         if (q_check_ptr(member))
             member->setMarkname(m.value("markname").toString());
     }
-    qDebug() << "set member marknames done";
+    uqqDebug(Contact) << "set member marknames done";
 }
 
 void UQQContact::setVipInfo(const QVariantList &list) {
     QVariantMap m;
     UQQMember *member;
-    qDebug() << "set members vip info...";
+    uqqDebug(Contact) << "set members vip info...";
     for (int i = 0; i < list.size(); i++) {
         m = list.at(i).toMap();
-        member = this->member(m.value("u").toString());
+        member = this->member(m.value("u").toULongLong());
         if (q_check_ptr(member)) {
             member->setVip(m.value("is_vip").toBool());
             member->setVipLevel(m.value("vip_level").toInt());
         }
     }
-    qDebug() << "set members vip info done.";
+    uqqDebug(Contact) << "set members vip info done.";
 }
 
 void UQQContact::setNickname(const QVariantList &list) {
     QVariantMap m;
     UQQMember *member;
-    qDebug() << "set member nickname...";
+    uqqDebug(Contact) << "set member nickname...";
     for (int i = 0; i < list.size(); i++) {
         m = list.at(i).toMap();
-        member = this->member(m.value("uin").toString());
+        member = this->member(m.value("uin").toULongLong());
         if (q_check_ptr(member))
             member->setNickname(m.value("nick").toString());
     }
-    qDebug() << "set member nickname done.";
+    uqqDebug(Contact) << "set member nickname done.";
 }
 
-void UQQContact::setCategories(const QVariantList &list) {
+/*
+ * Returns the categories that are no longer on the server, they are removed
+ * once their members have been moved.
+ */
+QList<UQQCategory *> UQQContact::setCategories(const QVariantList &list) {
     QVariantMap m;
     int index = UQQCategory::BuddyCategoryId;
-    UQQCategory *category = Q_NULLPTR;
-    qDebug() << "set categories...";
+    QSet<quint64> ids;
+    uqqDebug(Contact) << "set categories...";
 /*
     category = new UQQCategory();
     category->setName("在线好友");
     category->setId(UQQCategory::OnlineCategoryId);
     m_categories.append(category);
 */
-    category = new UQQCategory(this);
-    category->setName("我的好友");
-    category->setId(index);
-    m_categories.append(category);
+    ids.insert(index);
+    updateCategory(index, "我的好友");
 
     for (int i = 0; i < list.size(); i++) {
         m = list.at(i).toMap();
-        category = new UQQCategory(this);
-        category->setName(m.value("name").toString());
-        category->setId(++index);
-        m_categories.append(category);
+        ids.insert(++index);
+        updateCategory(index, m.value("name").toString());
     }
     index++;
-    category = new UQQCategory();
-    category->setName("陌生人");
-    category->setId(UQQCategory::StrangerCategoryId);
-    m_categories.append(category);
-    qDebug() << "set categories done, total categories:" << index + 1;
+    ids.insert(UQQCategory::StrangerCategoryId);
+    updateCategory(UQQCategory::StrangerCategoryId, "陌生人");
+    uqqDebug(Contact) << "set categories done, total categories:" << index + 1;
+
+    QList<UQQCategory *> stale;
+    foreach (UQQCategory *category, m_categories) {
+        if (!ids.contains(category->id()))
+            stale.append(category);
+    }
+    return stale;
+}
+
+// the stranger category is kept last, new categories go in front of it
+void UQQContact::updateCategory(quint64 id, const QString &name) {
+    UQQCategory *category = getCategory(id);
+    if (category) {
+        category->setName(name);
+        return;
+    }
+
+    category = new UQQCategory(this);
+    category->setName(name);
+    category->setId(id);
+    addCategory(category);
+}
+
+void UQQContact::addCategory(UQQCategory *category) {
+    int row = m_categories.size();
+    UQQCategory *stranger = getCategory(UQQCategory::StrangerCategoryId);
+    if (stranger)
+        row = m_categories.indexOf(stranger);
+
+    m_model->beginInsertRows(QModelIndex(), row, row);
+    m_categories.insert(row, category);
+    m_model->endInsertRows();
+    m_categoryIds.insert(category->id(), category);
+}
+
+void UQQContact::removeCategory(UQQCategory *category) {
+    int row = m_categories.indexOf(category);
+    if (row < 0) return;
+
+    foreach (UQQMember *member, category->members()) {
+        category->removeMember(member);
+        getCategory(UQQCategory::StrangerCategoryId)->addMember(member);
+    }
+
+    m_model->beginRemoveRows(QModelIndex(), row, row);
+    m_categories.removeAt(row);
+    m_model->endRemoveRows();
+    m_categoryIds.remove(category->id());
+    category->deleteLater();
 }
 
 void UQQContact::addMemberToCategory(quint64 id, UQQMember *member) {
@@ -125,52 +215,65 @@ void UQQContact::addMemberToCategory(quint64 id, UQQMember *member) {
     if (cat) {
         cat->addMember(member);
     } else {
-        qDebug() << "find a stranger:" << id << member->uin();
+        uqqDebug(Contact) << "find a stranger:" << id << member->uin();
         getCategory(UQQCategory::StrangerCategoryId)->addMember(member); // add to stranger category
     }
 }
 
 UQQCategory * UQQContact::getCategory(quint64 id) {
-    for (int i = 0; i < m_categories.size(); i++) {
-        if (m_categories.at(i)->id() == id) {
-            return m_categories.at(i);
-        }
-    }
-    return Q_NULLPTR;
+    return m_categoryIds.value(id, Q_NULLPTR);
+}
+
+/*
+ * The category the member was filed in by addMemberToCategory(),
+ * members with an unknown category id live in the stranger category.
+ */
+UQQCategory *UQQContact::memberCategory(UQQMember *member) {
+    if (member->gid() == UQQCategory::IllegalCategoryId)
+        return Q_NULLPTR;
+
+    UQQCategory *cat = getCategory(member->gid());
+    if (!cat)
+        cat = getCategory(UQQCategory::StrangerCategoryId);
+    return cat;
 }
 
 QList<UQQCategory *> &UQQContact::categories() {
     return m_categories;
 }
 
-QHash<QString, UQQMember*> &UQQContact::members() {
+UQQCategoryModel *UQQContact::model() const {
+    return m_model;
+}
+
+QHash<UQQUin, UQQMember*> &UQQContact::members() {
     return m_members;
 }
 
+UQQMember *UQQContact::member(UQQUin uin) {
+    return m_members.value(uin, Q_NULLPTR);
+}
+
 UQQMember *UQQContact::member(const QString &uin) {
     Q_ASSERT(uin.length() > 0);
-    if (m_members.contains(uin))
-        return m_members.value(uin);
-    else
-        return Q_NULLPTR;
+    return member(uin.toULongLong());
 }
 
 void UQQContact::setOnlineBuddies(const QVariantList &list) {
     QVariantMap m;
 
-    qDebug() << "set online buddies...";
+    uqqDebug(Contact) << "set online buddies...";
     // the list may contain duplicate member
     for (int i = 0; i < list.size(); i++) {
         m = list.at(i).toMap();
-        setBuddyStatus(m.value("uin").toString(),
+        setBuddyStatus(m.value("uin").toULongLong(),
                        UQQMember::statusIndex(m.value("status").toString()),
                        m.value("client_type").toInt());
     }
-    qDebug() << "set online buddies done. online members:" << list.size();
+    uqqDebug(Contact) << "set online buddies done. online members:" << list.size();
 }
 
-void UQQContact::setBuddyStatus(QString uin, int status, int clientType) {
-    Q_ASSERT(uin.length() > 0);
+void UQQContact::setBuddyStatus(UQQUin uin, int status, int clientType) {
     UQQMember *member = this->member(uin);
     if (!q_check_ptr(member)) return;
 
@@ -180,8 +283,9 @@ void UQQContact::setBuddyStatus(QString uin, int status, int clientType) {
 
     if (oldStatus == status) return;
 
-    UQQCategory *cat = getCategory(member->gid());
-    if (!q_check_ptr(cat)) return;
+    // the online count is maintained per change, never recounted
+    UQQCategory *cat = memberCategory(member);
+    if (!cat || !cat->hasMember(uin)) return;
 
     if (oldStatus == UQQMember::OfflineStatus) {  // offline -> online
         cat->incOnline();
@@ -204,20 +308,94 @@ QList<UQQMember *> UQQContact::membersInCategory(quint64 id, bool sorted) {
     return members;
 }
 
-void UQQContact::addSessMessage(UQQMessage *sessMessage) {
-    if (sessMessage) {
-        m_sessMessages.append(sessMessage);
+/*
+ * Session messages of strangers are kept per sender until their info
+ * arrives. When too many strangers are waiting the one that has waited
+ * longest is dropped, each keeps only its MaxSessMessages newest messages.
+ */
+void UQQContact::addSessMessage(const UQQMessage &sessMessage) {
+    UQQUin src = sessMessage.src();
+    QHash<UQQUin, QList<UQQMessage> >::Iterator iter = m_sessMessages.find(src);
+
+    if (iter == m_sessMessages.end()) {
+        if (m_sessMessages.size() >= MaxSessSenders) {
+            UQQUin oldest = m_sessSenders.takeFirst();
+            uqqDebug(Contact) << "drop session messages of" << oldest << m_sessMessages.value(oldest).size();
+            m_sessMessages.remove(oldest);
+        }
+        iter = m_sessMessages.insert(src, QList<UQQMessage>());
+        m_sessSenders.append(src);
+    }
+    if (iter.value().size() >= MaxSessMessages)
+        iter.value().removeFirst();
+    iter.value().append(sessMessage);
+}
+
+// hands the messages of the sender over, they are not kept here any more
+QList<UQQMessage> UQQContact::takeSessMessages(UQQUin uin) {
+    if (!m_sessMessages.contains(uin)) return QList<UQQMessage>();
+
+    m_sessSenders.removeOne(uin);
+    return m_sessMessages.take(uin);
+}
+
+/*
+ * Snapshot of the friend categories and their members, written by the
+ * client on every start and read back before the contact list is fetched.
+ * Statuses are not kept, every member starts offline.
+ */
+void UQQContact::save(QDataStream &out) {
+    QList<UQQCategory *> categories;
+    foreach (UQQCategory *category, m_categories) {
+        if (category->id() != UQQCategory::StrangerCategoryId)
+            categories.append(category);
+    }
+
+    out << qint32(categories.size());
+    foreach (UQQCategory *category, categories) {
+        QList<UQQMember *> members = category->members();
+        out << category->id() << category->name() << qint32(members.size());
+        foreach (UQQMember *member, members) {
+            out << member->uinKey() << member->markname() << member->nickname()
+                << member->longnick() << member->isVip() << qint32(member->vipLevel())
+                << member->face().toString();
+        }
     }
 }
 
-QList<UQQMessage *> UQQContact::getSessMessage(const QString &uin) {
-    UQQMessage *message;
-    QList<UQQMessage *> messages;
-    for (int i = 0; i < m_sessMessages.size(); i++) {
-        message = m_sessMessages.at(i);
-        if (message->src() == uin) {
-            messages.append(message);
+bool UQQContact::load(QDataStream &in) {
+    qint32 categoryCount = 0;
+    in >> categoryCount;
+
+    for (int i = 0; i < categoryCount && in.status() == QDataStream::Ok; i++) {
+        quint64 id;
+        QString name;
+        qint32 memberCount;
+        in >> id >> name >> memberCount;
+        if (in.status() != QDataStream::Ok) break;
+        updateCategory(id, name);
+
+        for (int j = 0; j < memberCount; j++) {
+            UQQUin uin;
+            QString markname, nickname, longnick, face;
+            bool vip;
+            qint32 vipLevel;
+            in >> uin >> markname >> nickname >> longnick >> vip >> vipLevel >> face;
+            if (in.status() != QDataStream::Ok) break;
+            if (uin == 0 || this->member(uin)) continue;
+
+            UQQMember *member = new UQQMember(id, QString::number(uin), this);
+            member->setMarkname(markname);
+            member->setNickname(nickname);
+            member->setLongnick(longnick);
+            member->setVip(vip);
+            member->setVipLevel(vipLevel);
+            if (!face.isEmpty() && QFile::exists(face))
+                member->setFace(face);
+            addMember(member);
         }
     }
-    return messages;
+    updateCategory(UQQCategory::StrangerCategoryId, "陌生人");
+
+    return in.status() == QDataStream::Ok;
 }
@@ -4,43 +4,61 @@
 #include <QtQml>
 #include "uqqcategory.h"
 #include "uqqmember.h"
+#include "uqqcategorymodel.h"
 
 class UQQContact : public QObject
 {
     Q_OBJECT
 public:
+    enum {
+        MaxSessSenders = 200,   // strangers with messages waiting for their info
+        MaxSessMessages = 50    // messages kept per stranger
+    };
 
     explicit UQQContact(QObject *parent = 0);
     ~UQQContact();
 
     void setContactData(const QVariantMap &map);
+    void save(QDataStream &out);
+    bool load(QDataStream &in);
     void setOnlineBuddies(const QVariantList &list);
     QList<UQQCategory *> &categories();
+    UQQCategoryModel *model() const;
     UQQCategory * getCategory(quint64 id);
-    QHash<QString, UQQMember*> &members();
+    QHash<UQQUin, UQQMember*> &members();
+    UQQMember *member(UQQUin uin);
     UQQMember *member(const QString &uin);
     QList<UQQMember *> membersInCategory(quint64 id, bool sorted = false);
     void addMember(UQQMember *member);
-    void setBuddyStatus(QString uin, int status, int clientType);
+    void setBuddyStatus(UQQUin uin, int status, int clientType);
 
-    void addSessMessage(UQQMessage *sessMessage);
-    QList<UQQMessage *> getSessMessage(const QString &uin);
+    void addSessMessage(const UQQMessage &sessMessage);
+    QList<UQQMessage> takeSessMessages(UQQUin uin);
 
 private:
-    void setCategories(const QVariantList &list);
+    QList<UQQCategory *> setCategories(const QVariantList &list);
     void setMembers(const QVariantList &list);
     void setMarknames(const QVariantList &list);
     void setVipInfo(const QVariantList &list);
     void setNickname(const QVariantList &list);
+    void updateCategory(quint64 id, const QString &name);
+    void addCategory(UQQCategory *category);
+    void removeCategory(UQQCategory *category);
+    void moveMember(UQQMember *member, quint64 gid);
+    bool isFriendCategory(quint64 id);
     void addMemberToCategory(quint64 id, UQQMember *member);
+    UQQCategory *memberCategory(UQQMember *member);
 signals:
 
 public slots:
 
 private:
     QList<UQQCategory *> m_categories;
-    QHash<QString, UQQMember*> m_members;
-    QList<UQQMessage *> m_sessMessages;
+    UQQCategoryModel *m_model;
+    QHash<quint64, UQQCategory *> m_categoryIds;
+    QHash<UQQUin, UQQMember*> m_members;
+    QHash<UQQUin, QList<UQQMessage> > m_sessMessages;
+    QList<UQQUin> m_sessSenders;    // oldest first
 };
 
 #endif // UQQCONTACT_H
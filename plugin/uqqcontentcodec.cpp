@@ -0,0 +1,222 @@
+#include "uqqcontentcodec.h"
+#include "uqqjsonreader.h"
+#include "uqqlog.h"
+
+static const char FontContent[] =
+        "[\"font\",{\"name\":\"Arial\",\"size\":\"10\",\"style\":[0,0,0],\"color\":\"000000\"}]";
+
+UQQContentCodec::UQQContentCodec() {
+}
+
+/*
+ * "content":"[\"hello\",[\"face\",1],\"world\",
+ * [\"font\",{\"name\":\"宋体\",\"size\":\"10\",\"style\":[0,0,0],\"color\":\"000000\"}]]"
+ */
+const QString &UQQContentCodec::encode(const QString &text) {
+    m_buffer.resize(0);     // keeps the capacity
+    m_buffer.reserve(text.size() + int(sizeof(FontContent)) + 16);
+    m_buffer.append(QLatin1Char('['));
+
+    const QChar *p = text.constData();
+    const QChar *end = p + text.size();
+    const QChar *run = p;   // start of the pending text run
+
+    while (p < end) {
+        int length;
+        if (p->unicode() == '[' && (length = matchFace(p, end)) > 0) {
+            if (run < p)
+                appendText(run, p);
+            // the digits between "[face" and "]", without leading zeros as JSON wants
+            const QChar *digits = p + 5;
+            int count = length - 6;
+            while (count > 1 && digits->unicode() == '0') {
+                digits++;
+                count--;
+            }
+            m_buffer.append(QLatin1String("[\"face\","));
+            m_buffer.append(digits, count);
+            m_buffer.append(QLatin1String("],"));
+            p += length;
+            run = p;
+        } else {
+            p++;
+        }
+    }
+    if (run < end)
+        appendText(run, end);
+
+    m_buffer.append(QLatin1String(FontContent)).append(QLatin1Char(']'));
+    return m_buffer;
+}
+
+// the length of the "[faceN]" token at p (N of 1 to 3 digits), 0 if there is none
+int UQQContentCodec::matchFace(const QChar *p, const QChar *end) {
+    static const char prefix[] = "[face";
+    const QChar *q = p;
+
+    for (int i = 0; prefix[i]; i++, q++) {
+        if (q == end || q->unicode() != ushort(prefix[i])) return 0;
+    }
+    const QChar *digits = q;
+    while (q < end && q - digits < 3 && q->unicode() >= '0' && q->unicode() <= '9')
+        q++;
+    if (q == digits || q == end || q->unicode() != ']') return 0;
+    return q + 1 - p;
+}
+
+void UQQContentCodec::appendText(const QChar *begin, const QChar *end) {
+    static const char hex[] = "0123456789abcdef";
+
+    m_buffer.append(QLatin1Char('"'));
+    const QChar *run = begin;   // characters that need no escaping are copied in runs
+    for (const QChar *p = begin; p < end; p++) {
+        ushort c = p->unicode();
+        if (c >= 0x20 && c != '"' && c != '\\' && !QChar::isSurrogate(c)) continue;
+        if (QChar::isHighSurrogate(c) && p + 1 < end && p[1].isLowSurrogate()) {
+            p++;    // a valid pair stays in the run
+            continue;
+        }
+
+        m_buffer.append(run, p - run);
+        run = p + 1;
+        switch (c) {
+        case '"':  m_buffer.append(QLatin1String("\\\"")); break;
+        case '\\': m_buffer.append(QLatin1String("\\\\")); break;
+        case '\n': m_buffer.append(QLatin1String("\\n")); break;
+        case '\r': m_buffer.append(QLatin1String("\\r")); break;
+        case '\t': m_buffer.append(QLatin1String("\\t")); break;
+        case '\b': m_buffer.append(QLatin1String("\\b")); break;
+        case '\f': m_buffer.append(QLatin1String("\\f")); break;
+        default:
+            if (QChar::isSurrogate(c)) {    // unpaired, it has no UTF-8 form
+                m_buffer.append(QLatin1String("\\ufffd"));
+                break;
+            }
+            m_buffer.append(QLatin1String("\\u00"));
+            m_buffer.append(QLatin1Char(hex[c >> 4])).append(QLatin1Char(hex[c & 0xf]));
+        }
+    }
+    m_buffer.append(run, end - run);
+    m_buffer.append(QLatin1String("\","));
+}
+
+/*
+ * "content":[["font",{"size":10,"color":"000000","style":[0,0,0],"name":"宋体"}],
+ * "hello",["face",14],"world "]
+ */
+void UQQContentCodec::decode(const QByteArray &content, UQQMessage *message) {
+    QVector<UQQMessageSegment> segments;
+    int fontStyle = 0;
+    segments.reserve(4);
+
+    UQQJsonReader reader(content);
+    if (reader.enterArray()) {
+        while (reader.nextElement()) {
+            switch (reader.peek()) {
+            case UQQJsonReader::StringValue:    // common text message
+                appendSegment(segments, reader.readString());
+                break;
+            case UQQJsonReader::ArrayValue: {   // font list, face number or another tag
+                reader.enterArray();
+                if (!reader.nextElement()) break;
+
+                QByteArray tag = reader.readRawString();
+                if (tag == "font") {
+                    if (reader.nextElement())
+                        fontStyle = readFontStyle(reader);
+                } else if (tag == "face") {
+                    UQQMessageSegment face;
+                    face.type = UQQMessageSegment::FaceSegment;
+                    if (reader.nextElement())
+                        face.face = int(reader.readInt());
+                    segments.append(face);
+                } else {    // pictures and the like are shown as their tag
+                    appendSegment(segments, QLatin1Char('[') + QString::fromUtf8(tag) + QLatin1Char(']'));
+                }
+                while (reader.nextElement())
+                    reader.skip();
+                break;
+            }
+            default: {
+                QByteArray raw = reader.readRaw();  // consumed even when not logged
+                uqqWarning(Message) << "unknown message type:" << raw;
+            }
+            }
+        }
+    }
+
+    message->setSegments(segments);
+    message->setFontStyle(fontStyle);
+}
+
+// the segments of a text form, for sent messages and those read from the log
+QVector<UQQMessageSegment> UQQContentCodec::split(const QString &text) {
+    QVector<UQQMessageSegment> segments;
+    const QChar *p = text.constData();
+    const QChar *end = p + text.size();
+    const QChar *run = p;
+
+    while (p < end) {
+        int length;
+        if (p->unicode() == '[' && (length = matchFace(p, end)) > 0) {
+            if (run < p)
+                appendSegment(segments, QString(run, p - run));
+            UQQMessageSegment face;
+            face.type = UQQMessageSegment::FaceSegment;
+            face.face = faceNumber(p, length);
+            segments.append(face);
+            p += length;
+            run = p;
+        } else {
+            p++;
+        }
+    }
+    if (run < end)
+        appendSegment(segments, QString(run, end - run));
+    return segments;
+}
+
+int UQQContentCodec::faceNumber(const QChar *p, int length) {
+    int n = 0;
+    for (const QChar *q = p + 5; q < p + length - 1; q++)
+        n = n * 10 + (q->unicode() - '0');
+    return n;
+}
+
+// adjacent text runs are merged into one segment
+void UQQContentCodec::appendSegment(QVector<UQQMessageSegment> &segments, const QString &text) {
+    if (!segments.isEmpty() && segments.last().type == UQQMessageSegment::TextSegment) {
+        segments.last().text.append(text);
+        return;
+    }
+    UQQMessageSegment segment;
+    segment.text = text;
+    segments.append(segment);
+}
+
+// {"size":10,"color":"000000","style":[0,0,0],"name":"宋体"}, style is bold, italic, underline
+int UQQContentCodec::readFontStyle(UQQJsonReader &reader) {
+    static const int styles[] = { UQQMessage::Bold, UQQMessage::Italic, UQQMessage::Underline };
+    int style = 0;
+
+    if (reader.peek() != UQQJsonReader::ObjectValue) {
+        reader.skip();
+        return style;
+    }
+
+    reader.enterObject();
+    while (reader.nextName()) {
+        if (reader.nameIs("style") && reader.peek() == UQQJsonReader::ArrayValue) {
+            reader.enterArray();
+            for (int i = 0; reader.nextElement(); i++) {
+                if (i >= 3)
+                    reader.skip();
+                else if (reader.readInt() != 0)
+                    style |= styles[i];
+            }
+        } else {
+            reader.skip();
+        }
+    }
+    return style;
+}
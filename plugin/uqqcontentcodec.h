@@ -0,0 +1,40 @@
+#ifndef UQQCONTENTCODEC_H
+#define UQQCONTENTCODEC_H
+
+#include <QString>
+#include <QByteArray>
+#include "uqqmessage.h"
+
+class UQQJsonReader;
+
+/*
+ * Converts between message text and the "content" arrays of the protocol.
+ *
+ * encode() makes one pass over the text: plain runs become JSON strings
+ * (escaped), "[faceN]" tokens become ["face",N] and the font entry closes
+ * the array. The result is built in a buffer that is reused by the next
+ * call, so its capacity is only grown, never reallocated per message.
+ *
+ * decode() reads a received content array into the segments and font
+ * style of a message, split() gives the segments of a text form.
+ */
+class UQQContentCodec
+{
+public:
+    UQQContentCodec();
+
+    const QString &encode(const QString &text);
+    static void decode(const QByteArray &content, UQQMessage *message);
+    static QVector<UQQMessageSegment> split(const QString &text);
+
+private:
+    static int matchFace(const QChar *p, const QChar *end);
+    static int faceNumber(const QChar *p, int length);
+    static void appendSegment(QVector<UQQMessageSegment> &segments, const QString &text);
+    static int readFontStyle(UQQJsonReader &reader);
+    void appendText(const QChar *begin, const QChar *end);
+
+    QString m_buffer;
+};
+
+#endif // UQQCONTENTCODEC_H
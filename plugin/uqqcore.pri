@@ -0,0 +1,55 @@
+# The client code shared by the QML plugin, tools/ and tests/.
+
+QT += qml network
+
+DEFINES += QT_NO_EXCEPTIONS="1" #UQQ_TEST
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += $$PWD/uqqclient.cpp \
+    $$PWD/uqqcontact.cpp \
+    $$PWD/uqqmember.cpp \
+    $$PWD/uqqcategory.cpp \
+    $$PWD/uqqmessage.cpp \
+    $$PWD/uqqmemberdetail.cpp \
+    $$PWD/uqqgroup.cpp \
+    $$PWD/uqqgroupinfo.cpp \
+    $$PWD/uqqjsonreader.cpp \
+    $$PWD/uqqmessagehistory.cpp \
+    $$PWD/uqqmembermodel.cpp \
+    $$PWD/uqqcategorymodel.cpp \
+    $$PWD/uqqfacecache.cpp \
+    $$PWD/uqqrequestscheduler.cpp \
+    $$PWD/uqqdemandqueue.cpp \
+    $$PWD/uqqpollengine.cpp \
+    $$PWD/uqqcontentcodec.cpp \
+    $$PWD/uqqsendqueue.cpp \
+    $$PWD/uqqrandom.cpp \
+    $$PWD/uqqnetworkmanager.cpp \
+    $$PWD/uqqmetrics.cpp \
+    $$PWD/uqqlog.cpp
+
+HEADERS += $$PWD/uqqclient.h \
+    $$PWD/uqqcontact.h \
+    $$PWD/uqqmember.h \
+    $$PWD/uqqcategory.h \
+    $$PWD/uqqmessage.h \
+    $$PWD/uqqmemberdetail.h \
+    $$PWD/uqqgroup.h \
+    $$PWD/uqqgroupinfo.h \
+    $$PWD/uqqjsonreader.h \
+    $$PWD/uqqmessagehistory.h \
+    $$PWD/uqqmembermodel.h \
+    $$PWD/uqqcategorymodel.h \
+    $$PWD/uqqfacecache.h \
+    $$PWD/uqqrequestscheduler.h \
+    $$PWD/uqqdemandqueue.h \
+    $$PWD/uqqpollengine.h \
+    $$PWD/uqqrequestcontext.h \
+    $$PWD/uqqcontentcodec.h \
+    $$PWD/uqqsendqueue.h \
+    $$PWD/uqqrandom.h \
+    $$PWD/uqqnetworkmanager.h \
+    $$PWD/uqqmetrics.h \
+    $$PWD/uqqlog.h
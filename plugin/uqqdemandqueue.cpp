@@ -0,0 +1,66 @@
+#include "uqqdemandqueue.h"
+
+UQQDemandQueue::UQQDemandQueue(QObject *parent)
+    : QObject(parent) {
+    m_tokens = Burst;
+    m_clock.start();
+
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(drain()));
+}
+
+QString UQQDemandQueue::key(const Demand &demand) {
+    return QString("%1:%2:%3").arg(demand.kind).arg(demand.gid).arg(demand.uin);
+}
+
+void UQQDemandQueue::add(int kind, quint64 gid, const QString &uin, bool urgent) {
+    Demand demand;
+    demand.kind = kind;
+    demand.gid = gid;
+    demand.uin = uin;
+
+    QString k = key(demand);
+    if (m_keys.contains(k)) {
+        if (!urgent) return;
+        for (int i = 0; i < m_queue.size(); i++) {
+            if (key(m_queue.at(i)) == k) {
+                m_queue.removeAt(i);
+                break;
+            }
+        }
+    }
+    m_keys.insert(k);
+
+    if (urgent) {
+        m_queue.prepend(demand);
+        m_timer->start(0);
+        return;
+    }
+
+    m_queue.append(demand);
+    while (m_queue.size() > MaxQueued)
+        m_keys.remove(key(m_queue.takeFirst()));
+    if (!m_timer->isActive())
+        m_timer->start(Window);
+}
+
+void UQQDemandQueue::clear() {
+    m_queue.clear();
+    m_keys.clear();
+    m_timer->stop();
+}
+
+void UQQDemandQueue::drain() {
+    m_tokens = qMin(double(Burst), m_tokens + m_clock.restart() * Rate / 1000.0);
+
+    while (m_tokens >= 1 && !m_queue.isEmpty()) {
+        Demand demand = m_queue.takeFirst();
+        m_keys.remove(key(demand));
+        m_tokens -= 1;
+        emit demanded(demand.kind, demand.gid, demand.uin);
+    }
+
+    if (!m_queue.isEmpty())
+        m_timer->start(qMax(1, int((1 - m_tokens) * 1000 / Rate)));
+}
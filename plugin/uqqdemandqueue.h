@@ -0,0 +1,59 @@
+#ifndef UQQDEMANDQUEUE_H
+#define UQQDEMANDQUEUE_H
+
+#include <QObject>
+#include <QList>
+#include <QSet>
+#include <QTimer>
+#include <QElapsedTimer>
+
+/*
+ * Collects member detail demands (long nick, level, info, account) and
+ * hands them out at a bounded rate.
+ *
+ * Demands are gathered for Window ms before the first one goes out, a
+ * demand already waiting is not queued twice, and a token bucket lets
+ * at most Rate demands per second through after an initial Burst. When
+ * more than MaxQueued are waiting the oldest ones are dropped, they
+ * belong to rows that were scrolled past. Urgent demands (the user opened
+ * a detail page) are put in front and skip the window.
+ */
+class UQQDemandQueue : public QObject
+{
+    Q_OBJECT
+public:
+    enum {
+        Window = 300,   // ms
+        Rate = 5,       // demands per second
+        Burst = 10,
+        MaxQueued = 200
+    };
+
+    explicit UQQDemandQueue(QObject *parent = 0);
+
+    void add(int kind, quint64 gid, const QString &uin, bool urgent = false);
+    void clear();
+
+signals:
+    void demanded(int kind, quint64 gid, const QString &uin);
+
+private slots:
+    void drain();
+
+private:
+    struct Demand {
+        int kind;
+        quint64 gid;
+        QString uin;
+    };
+
+    static QString key(const Demand &demand);
+
+    QList<Demand> m_queue;
+    QSet<QString> m_keys;
+    QTimer *m_timer;
+    QElapsedTimer m_clock;
+    double m_tokens;
+};
+
+#endif // UQQDEMANDQUEUE_H
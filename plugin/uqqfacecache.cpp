@@ -0,0 +1,155 @@
+#include "uqqfacecache.h"
+#include "uqqlog.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QSet>
+#include <QDataStream>
+#include <QDateTime>
+#include <QCryptographicHash>
+
+static qint64 now() {
+    return QDateTime::currentMSecsSinceEpoch() / 1000;
+}
+
+UQQFaceCache::UQQFaceCache() {
+    m_dirty = false;
+}
+
+// the face path of the logged in user, the index is read from it
+void UQQFaceCache::setPath(const QString &path) {
+    if (m_path == path) return;
+
+    m_path = path;
+    m_entries.clear();
+    m_dirty = false;
+    load();
+}
+
+QString UQQFaceCache::face(UQQUin uin) const {
+    QHash<UQQUin, Entry>::ConstIterator iter = m_entries.constFind(uin);
+    if (iter == m_entries.constEnd()) return QString();
+    return fileName(iter.value());
+}
+
+bool UQQFaceCache::isFresh(UQQUin uin) const {
+    QHash<UQQUin, Entry>::ConstIterator iter = m_entries.constFind(uin);
+    if (iter == m_entries.constEnd()) return false;
+    return now() - iter.value().fetchedAt < MaxAge;
+}
+
+QMap<QByteArray, QByteArray> UQQFaceCache::validators(UQQUin uin) const {
+    QMap<QByteArray, QByteArray> headers;
+    QHash<UQQUin, Entry>::ConstIterator iter = m_entries.constFind(uin);
+    if (iter == m_entries.constEnd()) return headers;
+
+    if (!iter.value().etag.isEmpty())
+        headers.insert("If-None-Match", iter.value().etag);
+    if (!iter.value().lastModified.isEmpty())
+        headers.insert("If-Modified-Since", iter.value().lastModified);
+    return headers;
+}
+
+/*
+ * Records a downloaded face and returns its file. The file is only written
+ * if no other uin has the same image already.
+ */
+QString UQQFaceCache::store(UQQUin uin, const QByteArray &data, const QString &ext,
+                            const QByteArray &etag, const QByteArray &lastModified) {
+    Entry entry;
+    entry.hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+    entry.ext = ext;
+    entry.etag = etag;
+    entry.lastModified = lastModified;
+    entry.fetchedAt = now();
+
+    QString path = fileName(entry);
+    if (!QFile::exists(path)) {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size()) {
+            uqqWarning(Contact) << "Error: write face" << path;
+            file.remove();
+            return QString();
+        }
+    }
+
+    m_entries.insert(uin, entry);
+    m_dirty = true;
+    return path;
+}
+
+// the server answered 304, the face on disk is good for another MaxAge
+QString UQQFaceCache::revalidate(UQQUin uin) {
+    QHash<UQQUin, Entry>::Iterator iter = m_entries.find(uin);
+    if (iter == m_entries.end()) return QString();
+
+    iter.value().fetchedAt = now();
+    m_dirty = true;
+    return fileName(iter.value());
+}
+
+QString UQQFaceCache::fileName(const Entry &entry) const {
+    return m_path + "/" + QString::fromLatin1(entry.hash) + entry.ext;
+}
+
+void UQQFaceCache::load() {
+    QFile file(m_path + "/index.dat");
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 version;
+    qint32 count;
+    in >> version >> count;
+    if (version != IndexVersion) return;
+
+    for (int i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        UQQUin uin;
+        Entry entry;
+        in >> uin >> entry.hash >> entry.ext >> entry.etag >> entry.lastModified >> entry.fetchedAt;
+        if (in.status() == QDataStream::Ok && QFile::exists(fileName(entry)))
+            m_entries.insert(uin, entry);
+    }
+    uqqDebug(Contact) << "face index loaded, faces:" << m_entries.size();
+    removeUnused();
+}
+
+// faces are named by their sha1, other files in the path are left alone
+void UQQFaceCache::removeUnused() {
+    QSet<QString> used;
+    foreach (const Entry &entry, m_entries)
+        used.insert(QString::fromLatin1(entry.hash) + entry.ext);
+
+    QDir dir(m_path);
+    int removed = 0;
+    foreach (const QString &name, dir.entryList(QDir::Files)) {
+        if (name.indexOf(QLatin1Char('.')) != 40 || used.contains(name)) continue;
+        if (dir.remove(name))
+            removed++;
+    }
+    if (removed)
+        uqqDebug(Contact) << "unused faces removed:" << removed;
+}
+
+void UQQFaceCache::save() {
+    if (!m_dirty || m_path.isEmpty()) return;
+
+    QSaveFile file(m_path + "/index.dat");
+    if (!file.open(QIODevice::WriteOnly)) {
+        uqqWarning(Contact) << "Error: open face index" << file.fileName();
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint32(IndexVersion) << qint32(m_entries.size());
+    for (QHash<UQQUin, Entry>::ConstIterator iter = m_entries.constBegin(); iter != m_entries.constEnd(); iter++) {
+        const Entry &entry = iter.value();
+        out << iter.key() << entry.hash << entry.ext << entry.etag << entry.lastModified << entry.fetchedAt;
+    }
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        uqqWarning(Contact) << "Error: save face index" << file.fileName();
+        return;     // the old index is kept, saved again next time
+    }
+    m_dirty = false;
+}
@@ -0,0 +1,59 @@
+#ifndef UQQFACECACHE_H
+#define UQQFACECACHE_H
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QByteArray>
+#include "uqqmember.h"
+
+/*
+ * The face images on disk, indexed by uin.
+ *
+ * Images are stored under their content hash, so the many members sharing
+ * a default face share one file (and one decoded pixmap in the QML image
+ * cache). Each uin remembers the hash and the validators of the last reply;
+ * a face younger than MaxAge is used without asking the server, an older
+ * one is revalidated with a conditional GET. Files no uin refers to any
+ * more, after a face changed, are removed when the index is loaded.
+ */
+class UQQFaceCache
+{
+public:
+    enum {
+        MaxAge = 3 * 24 * 3600,     // seconds
+        IndexVersion = 2
+    };
+
+    UQQFaceCache();
+
+    void setPath(const QString &path);
+    void save();
+
+    QString face(UQQUin uin) const;
+    bool isFresh(UQQUin uin) const;
+    QMap<QByteArray, QByteArray> validators(UQQUin uin) const;
+
+    QString store(UQQUin uin, const QByteArray &data, const QString &ext,
+                  const QByteArray &etag, const QByteArray &lastModified);
+    QString revalidate(UQQUin uin);
+
+private:
+    struct Entry {
+        QByteArray hash;
+        QString ext;
+        QByteArray etag;
+        QByteArray lastModified;
+        qint64 fetchedAt;
+    };
+
+    QString fileName(const Entry &entry) const;
+    void load();
+    void removeUnused();
+
+    QString m_path;
+    QHash<UQQUin, Entry> m_entries;
+    bool m_dirty;
+};
+
+#endif // UQQFACECACHE_H
@@ -1,8 +1,10 @@
 #include "uqqgroup.h"
+#include "uqqlog.h"
 
 UQQGroup::UQQGroup(QObject *parent) :
     QObject(parent)
 {
+    m_model = new UQQCategoryModel(m_groups, this);
 }
 
 void UQQGroup::setGroupData(const QVariantMap &map) {
@@ -14,7 +16,7 @@ void UQQGroup::setGroupData(const QVariantMap &map) {
 void UQQGroup::setGroupMaskList(const QVariantList &list) {
     QVariantMap m;
     UQQCategory *group = Q_NULLPTR;
-    qDebug() << "set group mask list...";
+    uqqDebug(Group) << "set group mask list...";
     for (int i = 0; i < list.size(); i++) {
         m = list.at(i).toMap();
         group = getGroupById(m.value("gid").toULongLong());
@@ -22,41 +24,64 @@ void UQQGroup::setGroupMaskList(const QVariantList &list) {
             group->setMessageMask(UQQCategory::GroupMessageMask(m.value("mask").toInt()));
         }
     }
-    qDebug() << "set group mask list done.";
+    uqqDebug(Group) << "set group mask list done.";
 }
 
+/*
+ * Groups read from the snapshot are updated in place, the ones the user
+ * has left since are removed.
+ */
 void UQQGroup::setGroupList(const QVariantList &list) {
     QVariantMap m;
+    QSet<quint64> gids;
     UQQCategory *group = Q_NULLPTR;
-    qDebug() << "set group list...";
+    uqqDebug(Group) << "set group list...";
     for (int i = 0; i < list.size(); i++) {
         m = list.at(i).toMap();
-        group = new UQQCategory(this);
+        quint64 gid = m.value("gid").toULongLong();
+        gids.insert(gid);
+
+        if ((group = getGroupById(gid)) == Q_NULLPTR) {
+            group = new UQQCategory(this);
+            group->setId(gid);
+            group->setCode(m.value("code").toLongLong());
+            addGroup(group);
+        } else if (group->code() != m.value("code").toULongLong()) {
+            m_groupCodes.remove(group->code());
+            group->setCode(m.value("code").toLongLong());
+            m_groupCodes.insert(group->code(), group);
+        }
         group->setName(m.value("name").toString());
-        group->setId(m.value("gid").toLongLong());
         group->setFlag(m.value("flag").toLongLong());
-        group->setCode(m.value("code").toLongLong());
-        m_groups.append(group);
     }
-    qDebug() << "group list done, total group:" << list.size();
+
+    QList<UQQCategory *> stale;
+    foreach (group, m_groups) {
+        if (!gids.contains(group->id()))
+            stale.append(group);
+    }
+    foreach (group, stale) {
+        removeGroup(group);
+    }
+    uqqDebug(Group) << "group list done, total group:" << list.size() << "removed:" << stale.size();
 }
 
 void UQQGroup::setGroupMarkList(const QVariantList &list) {
     QVariantMap m;
     UQQCategory *group = Q_NULLPTR;
-    qDebug() << "set group markname list...";
+    uqqDebug(Group) << "set group markname list...";
     for (int i = 0; i < list.size(); i++) {
         m = list.at(i).toMap();
         group = getGroupById(m.value("uin").toULongLong());
         if (q_check_ptr(group))
             group->setMarkname(m.value("markname").toString());
     }
-    qDebug() << "group markname list done, total markname list:" << list.size();
+    uqqDebug(Group) << "group markname list done, total markname list:" << list.size();
 }
 
 void UQQGroup::setGroupDetail(quint64 gid, const QVariantMap &map, UQQContact *contact) {
     UQQCategory *group = getGroupById(gid);
-    if (!q_check_ptr(group) || group->groupReady()) return;
+    if (!q_check_ptr(group)) return;
 
     QVariantMap m = map.value("ginfo").toMap();
     setGroupInfo(group, map);
@@ -70,10 +95,12 @@ void UQQGroup::setGroupDetail(quint64 gid, const QVariantMap &map, UQQContact *c
 }
 
 void UQQGroup::setGroupInfo(UQQCategory *group, const QVariantMap &map) {
-    qDebug() << "set group info..." << group->id();
+    uqqDebug(Group) << "set group info..." << group->id();
 
     QVariantMap m = map.value("ginfo").toMap();
-    UQQGroupInfo *groupInfo = new UQQGroupInfo(group);
+    UQQGroupInfo *groupInfo = group->groupInfo();
+    if (!groupInfo)
+        groupInfo = new UQQGroupInfo(group);
     groupInfo->setFaceid(m.value("face").toInt());
     groupInfo->setMemo(m.value("memo").toString());
     groupInfo->setFingerMemo(m.value("fingermemo").toString());
@@ -84,37 +111,50 @@ void UQQGroup::setGroupInfo(UQQCategory *group, const QVariantMap &map) {
     groupInfo->setLevel(m.value("level").toInt());
     groupInfo->setOwner(m.value("owner").toString());
     group->setGroupInfo(groupInfo);
-    qDebug() << "set group info done.";
+    uqqDebug(Group) << "set group info done.";
 }
 
 void UQQGroup::setGroupMembers(UQQCategory *group, const QVariantList &members, UQQContact *contact) {
     QVariantMap m;
-    QString uin;
+    UQQUin uin;
+    QSet<UQQUin> uins;
     UQQMember *member;
-    qDebug() << "set group members...";
+    uqqDebug(Group) << "set group members...";
     for (int i = 0; i < members.size(); i++) {
         m = members.at(i).toMap();
-        uin = m.value("uin").toString();
+        uin = m.value("uin").toULongLong();
+        uins.insert(uin);
         if ((member = contact->member(uin)) != Q_NULLPTR) {
             group->addMember(member);
             continue;
         }
 
-        member = new UQQMember(group->id(), uin, this);
+        if ((member = group->member(uin)) == Q_NULLPTR) {
+            member = new UQQMember(group->id(), QString::number(uin), this);
+            member->setIsFriend(false);
+        }
         member->setNickname(m.value("nick").toString());
-        member->setIsFriend(false);
         group->addMember(member);
     }
-    qDebug() << "set group members done, group members:" << members.size();
+
+    // members that left the group since the snapshot was taken
+    foreach (member, group->members()) {
+        if (uins.contains(member->uinKey())) continue;
+
+        group->removeMember(member);
+        if (member->parent() == this)
+            member->deleteLater();
+    }
+    uqqDebug(Group) << "set group members done, group members:" << members.size();
 }
 
 void UQQGroup::setMembersStats(UQQCategory *group, const QVariantList &stats) {
     QVariantMap m;
     UQQMember *member;
-    qDebug() << "set group member stats..." << group->name();
+    uqqDebug(Group) << "set group member stats..." << group->name();
     for (int i = 0; i < stats.size(); i++) {
         m = stats.at(i).toMap();
-        member = group->member(m.value("uin").toString());
+        member = group->member(m.value("uin").toULongLong());
         if (q_check_ptr(member)) {
             member->setClientType(m.value("client_type").toInt());
             member->setStatus(m.value("stat").toInt() / 10);
@@ -128,77 +168,87 @@ void UQQGroup::setMembersStats(UQQCategory *group, const QVariantList &stats) {
         }
     }
 
-    qDebug() << "set group member stats done, online members:" << stats.size();
+    uqqDebug(Group) << "set group member stats done, online members:" << stats.size();
 }
 
 void UQQGroup::setMembersFlags(UQQCategory *group, const QVariantList &flags) {
     QVariantMap m;
     UQQMember *member;
-    qDebug() << "set group member flags...";
+    uqqDebug(Group) << "set group member flags...";
     for (int i = 0; i < flags.size(); i++) {
         m = flags.at(i).toMap();
-        member = group->member(m.value("muin").toString());
+        member = group->member(m.value("muin").toULongLong());
         if (q_check_ptr(member)) {
             member->setFlag(m.value("mflag").toInt());
         }
     }
-    qDebug() << "set group member flags done.";
+    uqqDebug(Group) << "set group member flags done.";
 }
 
 void UQQGroup::setVipInfo(UQQCategory *group, const QVariantList &vips) {
     QVariantMap m;
     UQQMember *member;
 
-    qDebug() << "set group member vip info...";
+    uqqDebug(Group) << "set group member vip info...";
     for (int i = 0; i < vips.size(); i++) {
         m = vips.at(i).toMap();
-        member = group->member(m.value("u").toString());
+        member = group->member(m.value("u").toULongLong());
         if (q_check_ptr(member)) {
             member->setVip(m.value("is_vip").toBool());
             member->setVipLevel(m.value("vip_level").toInt());
         }
     }
-    qDebug() << "set group member vip info done.";
+    uqqDebug(Group) << "set group member vip info done.";
 }
 
 void UQQGroup::setMembersCards(UQQCategory *group, const QVariantList &cards) {
     QVariantMap m;
     UQQMember *member;
-    qDebug() << "set group member cards...";
+    uqqDebug(Group) << "set group member cards...";
     for (int i = 0; i < cards.size(); i++) {
         m = cards.at(i).toMap();
-        member = group->member(m.value("muin").toString());
+        member = group->member(m.value("muin").toULongLong());
         if (q_check_ptr(member)) {
             member->setCard(m.value("card").toString());
         }
     }
-    qDebug() << "set group member cards done.";
+    uqqDebug(Group) << "set group member cards done.";
 }
 
 QList<UQQCategory *> &UQQGroup::groups() {
      return m_groups;
 }
 
-UQQCategory *UQQGroup::getGroupById(quint64 gid) {
-    for (int i = 0; i < m_groups.size(); i++) {
-        if (m_groups.at(i)->id() == gid) {
-            return m_groups.at(i);
-        }
-    }
+UQQCategoryModel *UQQGroup::model() const {
+    return m_model;
+}
 
-    qDebug() << "group id" << gid << "not found!";
-    return Q_NULLPTR;
+void UQQGroup::removeGroup(UQQCategory *group) {
+    int row = m_groups.indexOf(group);
+    if (row < 0) return;
+
+    m_model->beginRemoveRows(QModelIndex(), row, row);
+    m_groups.removeAt(row);
+    m_model->endRemoveRows();
+    m_groupIds.remove(group->id());
+    m_groupCodes.remove(group->code());
+    group->deleteLater();
 }
 
-UQQCategory *UQQGroup::getGroupByCode(quint64 gcode) {
-    for (int i = 0; i < m_groups.size(); i++) {
-        if (m_groups.at(i)->code() == gcode) {
-            return m_groups.at(i);
-        }
-    }
+void UQQGroup::addGroup(UQQCategory *group) {
+    m_model->beginInsertRows(QModelIndex(), m_groups.size(), m_groups.size());
+    m_groups.append(group);
+    m_model->endInsertRows();
+    m_groupIds.insert(group->id(), group);
+    m_groupCodes.insert(group->code(), group);
+}
 
-    qDebug() << "group code" << gcode << "not found!";
-    return Q_NULLPTR;
+UQQCategory *UQQGroup::getGroupById(quint64 gid) {
+    return m_groupIds.value(gid, Q_NULLPTR);
+}
+
+UQQCategory *UQQGroup::getGroupByCode(quint64 gcode) {
+    return m_groupCodes.value(gcode, Q_NULLPTR);
 }
 
 QList<UQQMember *> UQQGroup::memberInGroup(quint64 gid, bool sorted) {
@@ -213,3 +263,98 @@ QList<UQQMember *> UQQGroup::memberInGroup(quint64 gid, bool sorted) {
     return members;
 }
 
+/*
+ * Snapshot of the group list. The members of groups whose info was loaded
+ * are kept too, friends among them are shared with the contact list, so
+ * the contact snapshot must be loaded first.
+ */
+void UQQGroup::save(QDataStream &out) {
+    out << qint32(m_groups.size());
+    foreach (UQQCategory *group, m_groups) {
+        out << group->id() << group->code() << group->flag() << group->name()
+            << group->markname() << qint32(group->messageMask()) << group->groupReady();
+        if (!group->groupReady()) continue;
+
+        UQQGroupInfo *info = group->groupInfo();
+        UQQGroupInfo empty;
+        if (!info) info = &empty;
+        out << qint32(info->faceid()) << info->memo() << info->fingerMemo() << info->gclass()
+            << info->createTime() << qint32(info->flag()) << qint32(info->level()) << info->owner();
+
+        QList<UQQMember *> members = group->members();
+        out << qint32(members.size());
+        foreach (UQQMember *member, members) {
+            out << member->uinKey() << member->isFriend() << member->nickname() << member->card()
+                << qint32(member->flag()) << member->isVip() << qint32(member->vipLevel());
+        }
+    }
+}
+
+bool UQQGroup::load(QDataStream &in, UQQContact *contact) {
+    qint32 groupCount = 0;
+    in >> groupCount;
+
+    for (int i = 0; i < groupCount && in.status() == QDataStream::Ok; i++) {
+        quint64 gid, code;
+        quint32 flag;
+        QString name, markname;
+        qint32 mask;
+        bool ready;
+        in >> gid >> code >> flag >> name >> markname >> mask >> ready;
+        if (in.status() != QDataStream::Ok || getGroupById(gid)) break;
+
+        UQQCategory *group = new UQQCategory(this);
+        group->setId(gid);
+        group->setCode(code);
+        group->setFlag(flag);
+        group->setName(name);
+        group->setMarkname(markname);
+        group->setMessageMask(UQQCategory::GroupMessageMask(mask));
+        addGroup(group);
+        if (!ready) continue;
+
+        qint32 faceid, infoFlag, level, memberCount;
+        QString memo, fingerMemo, gclass, owner;
+        QDateTime createTime;
+        in >> faceid >> memo >> fingerMemo >> gclass >> createTime >> infoFlag >> level >> owner;
+        in >> memberCount;
+        if (in.status() != QDataStream::Ok) break;
+
+        UQQGroupInfo *info = new UQQGroupInfo(group);
+        info->setFaceid(faceid);
+        info->setMemo(memo);
+        info->setFingerMemo(fingerMemo);
+        info->setGclass(gclass);
+        info->setCreateTime(createTime);
+        info->setFlag(infoFlag);
+        info->setLevel(level);
+        info->setOwner(owner);
+        group->setGroupInfo(info);
+
+        int j = 0;
+        for (; j < memberCount; j++) {
+            UQQUin uin;
+            QString nickname, card;
+            bool isFriend, vip;
+            qint32 memberFlag, vipLevel;
+            in >> uin >> isFriend >> nickname >> card >> memberFlag >> vip >> vipLevel;
+            if (in.status() != QDataStream::Ok) break;
+
+            UQQMember *member = isFriend ? contact->member(uin) : Q_NULLPTR;
+            if (!member) {
+                member = new UQQMember(gid, QString::number(uin), this);
+                member->setIsFriend(false);
+                member->setNickname(nickname);
+                member->setVip(vip);
+                member->setVipLevel(vipLevel);
+            }
+            member->setCard(card);
+            member->setFlag(memberFlag);
+            group->addMember(member);
+        }
+        if (j < memberCount) break;     // truncated, the info is requested again
+        group->setGroupReady(true);
+    }
+
+    return in.status() == QDataStream::Ok;
+}
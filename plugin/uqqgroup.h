@@ -4,6 +4,7 @@
 #include <QtQml>
 #include "uqqcategory.h"
 #include "uqqcontact.h"
+#include "uqqcategorymodel.h"
 
 class UQQGroup : public QObject
 {
@@ -14,7 +15,10 @@ public:
 
     void setGroupData(const QVariantMap &map);
     void setGroupDetail(quint64 gid, const QVariantMap &map, UQQContact *contact);
+    void save(QDataStream &out);
+    bool load(QDataStream &in, UQQContact *contact);
     QList<UQQCategory *> &groups();
+    UQQCategoryModel *model() const;
     UQQCategory *getGroupById(quint64 gid);
     UQQCategory *getGroupByCode(quint64 gcode);
     QList<UQQMember *> memberInGroup(quint64 gid, bool sorted);
@@ -33,9 +37,14 @@ private:
     void setMembersFlags(UQQCategory *group, const QVariantList &flags);
     void setMembersCards(UQQCategory *group, const QVariantList &cards);
     void setVipInfo(UQQCategory *group, const QVariantList &vips);
+    void addGroup(UQQCategory *group);
+    void removeGroup(UQQCategory *group);
     
 private:
-    QList<UQQCategory *> m_groups;
+    QList<UQQCategory *> m_groups;          // keeps the server order for getGroupList()
+    QHash<quint64, UQQCategory *> m_groupIds;
+    QHash<quint64, UQQCategory *> m_groupCodes;
+    UQQCategoryModel *m_model;
 };
 
 #endif // UQQGROUP_H
@@ -0,0 +1,385 @@
+#include "uqqjsonreader.h"
+
+UQQJsonReader::UQQJsonReader(const QByteArray &data)
+    : m_data(data) {
+    m_pos = m_data.constData();
+    m_end = m_pos + m_data.size();
+    m_name = m_pos;
+    m_nameLength = 0;
+    m_error = false;
+}
+
+bool UQQJsonReader::hasError() const {
+    return m_error;
+}
+
+void UQQJsonReader::setError() {
+    m_error = true;
+    m_pos = m_end;
+}
+
+void UQQJsonReader::skipWhitespace() {
+    while (m_pos < m_end &&
+           (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+        m_pos++;
+}
+
+bool UQQJsonReader::expect(char c) {
+    skipWhitespace();
+    if (m_pos < m_end && *m_pos == c) {
+        m_pos++;
+        return true;
+    }
+    setError();
+    return false;
+}
+
+UQQJsonReader::ValueType UQQJsonReader::peek() {
+    skipWhitespace();
+    if (m_pos >= m_end)
+        return NoValue;
+
+    switch (*m_pos) {
+    case '{':
+        return ObjectValue;
+    case '[':
+        return ArrayValue;
+    case '"':
+        return StringValue;
+    case 't':
+    case 'f':
+        return BoolValue;
+    case 'n':
+        return NullValue;
+    default:
+        if (*m_pos == '-' || (*m_pos >= '0' && *m_pos <= '9'))
+            return NumberValue;
+    }
+    return NoValue;
+}
+
+bool UQQJsonReader::enterObject() {
+    if (peek() != ObjectValue) return false;
+    m_pos++;
+    return true;
+}
+
+/*
+ * Moves to the next member of the current object and consumes its name,
+ * the member value must be read or skipped before calling it again.
+ * Returns false after consuming the closing '}' and once the reader is in
+ * an error state, so loops over malformed input always end.
+ */
+bool UQQJsonReader::nextName() {
+    if (m_error) return false;
+    skipWhitespace();
+    if (m_pos >= m_end) {
+        setError();
+        return false;
+    }
+    if (*m_pos == '}') {
+        m_pos++;
+        return false;
+    }
+    if (*m_pos == ',') {
+        m_pos++;
+        skipWhitespace();
+    }
+
+    const char *begin;
+    const char *end;
+    bool escaped;
+    if (m_pos >= m_end || *m_pos != '"' || !scanString(&begin, &end, &escaped)) {
+        setError();
+        return false;
+    }
+    m_name = begin;
+    m_nameLength = end - begin;
+
+    return expect(':');
+}
+
+QByteArray UQQJsonReader::name() const {
+    return QByteArray::fromRawData(m_name, m_nameLength);
+}
+
+bool UQQJsonReader::nameIs(const char *name) const {
+    int length = qstrlen(name);
+    return length == m_nameLength && memcmp(m_name, name, length) == 0;
+}
+
+bool UQQJsonReader::enterArray() {
+    if (peek() != ArrayValue) return false;
+    m_pos++;
+    return true;
+}
+
+/*
+ * Moves to the next element of the current array.
+ * Returns false after consuming the closing ']' and once the reader is in
+ * an error state.
+ */
+bool UQQJsonReader::nextElement() {
+    if (m_error) return false;
+    skipWhitespace();
+    if (m_pos >= m_end) {
+        setError();
+        return false;
+    }
+    if (*m_pos == ']') {
+        m_pos++;
+        return false;
+    }
+    if (*m_pos == ',') {
+        m_pos++;
+        skipWhitespace();
+    }
+    return true;
+}
+
+QString UQQJsonReader::readString() {
+    const char *begin;
+    const char *end;
+    bool escaped;
+
+    switch (peek()) {
+    case StringValue:
+        if (!scanString(&begin, &end, &escaped)) return QString();
+        return escaped ? decodeString(begin, end) : QString::fromUtf8(begin, end - begin);
+    case NumberValue:
+    case BoolValue:
+        begin = m_pos;
+        skip();
+        return QString::fromLatin1(begin, m_pos - begin);
+    default:
+        skip();
+        return QString();
+    }
+}
+
+/*
+ * Returns the undecoded bytes of the next string without copying them,
+ * strings with escape sequences are decoded into a new buffer.
+ */
+QByteArray UQQJsonReader::readRawString() {
+    const char *begin;
+    const char *end;
+    bool escaped;
+
+    if (peek() != StringValue)
+        return readRaw();
+
+    if (!scanString(&begin, &end, &escaped)) return QByteArray();
+    if (escaped)
+        return decodeString(begin, end).toUtf8();
+    return QByteArray::fromRawData(begin, end - begin);
+}
+
+qint64 UQQJsonReader::readInt() {
+    const char *begin;
+    const char *end;
+    bool escaped;
+    bool negative = false;
+    quint64 value = 0;
+
+    switch (peek()) {
+    case NumberValue:
+        if (!scanNumber(&begin, &end)) return 0;
+        value = parseDigits(begin, end, &negative);
+        break;
+    case StringValue:   // some fields carry numbers as strings
+        if (!scanString(&begin, &end, &escaped)) return 0;
+        value = parseDigits(begin, end, &negative);
+        break;
+    case BoolValue:
+        return readBool() ? 1 : 0;
+    default:
+        skip();
+        return 0;
+    }
+    return negative ? -qint64(value) : qint64(value);
+}
+
+quint64 UQQJsonReader::readUInt() {
+    return quint64(readInt());
+}
+
+double UQQJsonReader::readDouble() {
+    const char *begin;
+    const char *end;
+    bool escaped;
+
+    switch (peek()) {
+    case NumberValue:
+        if (!scanNumber(&begin, &end)) return 0;
+        break;
+    case StringValue:
+        if (!scanString(&begin, &end, &escaped)) return 0;
+        break;
+    default:
+        return readInt();
+    }
+    return QByteArray(begin, end - begin).toDouble();
+}
+
+bool UQQJsonReader::readBool() {
+    switch (peek()) {
+    case BoolValue: {
+        bool value = (*m_pos == 't');
+        skip();
+        return value;
+    }
+    case NumberValue:
+    case StringValue:
+        return readInt() != 0;
+    default:
+        skip();
+        return false;
+    }
+}
+
+QByteArray UQQJsonReader::readRaw() {
+    if (peek() == NoValue) {
+        setError();
+        return QByteArray();
+    }
+
+    const char *begin = m_pos;
+    skip();
+    if (m_error) return QByteArray();
+    return QByteArray::fromRawData(begin, m_pos - begin);
+}
+
+void UQQJsonReader::skip() {
+    const char *begin;
+    const char *end;
+    bool escaped;
+    int depth = 0;
+
+    switch (peek()) {
+    case StringValue:
+        scanString(&begin, &end, &escaped);
+        break;
+    case NumberValue:
+        scanNumber(&begin, &end);
+        break;
+    case BoolValue:
+    case NullValue:
+        while (m_pos < m_end && *m_pos >= 'a' && *m_pos <= 'z')
+            m_pos++;
+        break;
+    case ObjectValue:
+    case ArrayValue:
+        do {
+            if (*m_pos == '"') {
+                if (!scanString(&begin, &end, &escaped)) return;
+                continue;
+            }
+            if (*m_pos == '{' || *m_pos == '[')
+                depth++;
+            else if (*m_pos == '}' || *m_pos == ']')
+                depth--;
+            m_pos++;
+        } while (depth > 0 && m_pos < m_end);
+
+        if (depth > 0) setError();
+        break;
+    default:
+        setError();
+    }
+}
+
+bool UQQJsonReader::scanString(const char **begin, const char **end, bool *escaped) {
+    const char *p = m_pos + 1;    // skip the opening '"'
+    *escaped = false;
+    *begin = p;
+
+    while (p < m_end && *p != '"') {
+        if (*p == '\\') {
+            *escaped = true;
+            p++;
+        }
+        p++;
+    }
+
+    if (p >= m_end) {
+        setError();
+        return false;
+    }
+    *end = p;
+    m_pos = p + 1;
+    return true;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+QString UQQJsonReader::decodeString(const char *begin, const char *end) const {
+    QString result;
+    const char *run = begin;
+    const char *p = begin;
+
+    result.reserve(end - begin);
+    while (p < end) {
+        if (*p != '\\') {
+            p++;
+            continue;
+        }
+
+        if (p > run)
+            result.append(QString::fromUtf8(run, p - run));
+        p++;    // skip the '\\'
+
+        switch (*p) {
+        case 'n': result.append(QLatin1Char('\n')); break;
+        case 't': result.append(QLatin1Char('\t')); break;
+        case 'r': result.append(QLatin1Char('\r')); break;
+        case 'b': result.append(QLatin1Char('\b')); break;
+        case 'f': result.append(QLatin1Char('\f')); break;
+        case 'u': {
+            // surrogate pairs arrive as two escapes and are appended unit by unit
+            ushort unicode = 0;
+            int i;
+            for (i = 1; i <= 4 && p + i < end && hexValue(p[i]) >= 0; i++)
+                unicode = (unicode << 4) | hexValue(p[i]);
+            result.append(QChar(unicode));
+            p += i - 1;
+            break;
+        }
+        default:        // '"', '\\' and '/'
+            result.append(QLatin1Char(*p));
+        }
+        p++;
+        run = p;
+    }
+    if (end > run)
+        result.append(QString::fromUtf8(run, end - run));
+
+    return result;
+}
+
+bool UQQJsonReader::scanNumber(const char **begin, const char **end) {
+    *begin = m_pos;
+    while (m_pos < m_end &&
+           ((*m_pos >= '0' && *m_pos <= '9') ||
+            *m_pos == '-' || *m_pos == '+' || *m_pos == '.' || *m_pos == 'e' || *m_pos == 'E'))
+        m_pos++;
+    *end = m_pos;
+    return *end > *begin;
+}
+
+quint64 UQQJsonReader::parseDigits(const char *begin, const char *end, bool *negative) const {
+    quint64 value = 0;
+    const char *p = begin;
+
+    *negative = (p < end && *p == '-');
+    if (*negative) p++;
+
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+        value = value * 10 + (*p - '0');
+    return value;
+}
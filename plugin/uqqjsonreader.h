@@ -0,0 +1,77 @@
+#ifndef UQQJSONREADER_H
+#define UQQJSONREADER_H
+
+#include <QByteArray>
+#include <QString>
+
+/*
+ * A forward-only JSON cursor over a byte array.
+ *
+ * Values are decoded straight from the buffer as they are visited, nothing
+ * is materialized into QVariant/QJsonValue trees. Nested values can be
+ * captured with readRaw() and handed to another reader later; the captured
+ * span refers to the original buffer, so it must outlive the readers.
+ *
+ *  UQQJsonReader reader(data);
+ *  if (reader.enterObject()) {
+ *      while (reader.nextName()) {
+ *          if (reader.nameIs("retcode"))
+ *              retCode = reader.readInt();
+ *          else
+ *              reader.skip();
+ *      }
+ *  }
+ */
+class UQQJsonReader
+{
+public:
+    enum ValueType {
+        NoValue,
+        ObjectValue,
+        ArrayValue,
+        StringValue,
+        NumberValue,
+        BoolValue,
+        NullValue
+    };
+
+    explicit UQQJsonReader(const QByteArray &data);
+
+    bool hasError() const;
+    ValueType peek();
+
+    bool enterObject();
+    bool nextName();
+    QByteArray name() const;
+    bool nameIs(const char *name) const;
+
+    bool enterArray();
+    bool nextElement();
+
+    QString readString();
+    QByteArray readRawString();
+    qint64 readInt();
+    quint64 readUInt();
+    double readDouble();
+    bool readBool();
+    QByteArray readRaw();
+    void skip();
+
+private:
+    void skipWhitespace();
+    bool expect(char c);
+    void setError();
+    bool scanString(const char **begin, const char **end, bool *escaped);
+    QString decodeString(const char *begin, const char *end) const;
+    bool scanNumber(const char **begin, const char **end);
+    quint64 parseDigits(const char *begin, const char *end, bool *negative) const;
+
+    QByteArray m_data;
+    const char *m_pos;
+    const char *m_end;
+    const char *m_name;
+    int m_nameLength;
+    bool m_error;
+};
+
+#endif // UQQJSONREADER_H
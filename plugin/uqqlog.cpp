@@ -0,0 +1,209 @@
+#include "uqqlog.h"
+#include <QThread>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QDateTime>
+#include <QCoreApplication>
+#include <stdio.h>
+
+UQQLog::Level UQQLog::s_levels[UQQLog::CategoryCount] = {
+    Warning, Warning, Warning, Warning, Warning, Warning, Warning
+};
+
+static const char *const CategoryNames[UQQLog::CategoryCount] = {
+    "general", "net", "login", "poll", "contact", "group", "message"
+};
+
+static const char LevelTags[] = { 'D', 'I', 'W', 'E' };
+
+namespace {
+
+struct Entry {
+    qint64 time;
+    UQQLog::Category category;
+    UQQLog::Level level;
+    QString text;
+};
+
+/*
+ * Single producer, single consumer. The producer owns the slots from head
+ * to tail, the consumer the ones from tail to head; each side publishes
+ * its index with a release store once it is done with the slot.
+ */
+class Ring
+{
+public:
+    enum { Capacity = 4096 };   // a power of two
+
+    Ring() : m_head(0), m_tail(0), m_dropped(0) {}
+
+    bool push(const Entry &entry) {
+        int head = m_head.load();
+        if (head - m_tail.loadAcquire() == Capacity) {
+            m_dropped.ref();
+            return false;
+        }
+        m_entries[head & (Capacity - 1)] = entry;
+        m_head.storeRelease(head + 1);
+        return true;
+    }
+
+    bool pop(Entry *entry) {
+        int tail = m_tail.load();
+        if (tail == m_head.loadAcquire()) return false;
+
+        Entry &slot = m_entries[tail & (Capacity - 1)];
+        *entry = slot;
+        slot.text = QString();  // the text is freed on this thread
+        m_tail.storeRelease(tail + 1);
+        return true;
+    }
+
+    int takeDropped() {
+        return m_dropped.fetchAndStoreRelaxed(0);
+    }
+
+private:
+    Entry m_entries[Capacity];
+    QAtomicInt m_head;
+    QAtomicInt m_tail;
+    QAtomicInt m_dropped;
+};
+
+class Writer : public QThread
+{
+public:
+    explicit Writer(QThread *producer) : m_producer(producer), m_stop(0) {
+        QByteArray fileName = qgetenv("UQQ_LOG_FILE");
+        m_out = fileName.isEmpty() ? Q_NULLPTR : fopen(fileName.constData(), "a");
+        if (!m_out) m_out = stderr;
+    }
+
+    ~Writer() {
+        if (m_out != stderr) fclose(m_out);
+    }
+
+    Ring ring;
+    QThread *m_producer;
+
+    void stop() {
+        m_stop.storeRelease(1);
+        wait();
+        drain();    // whatever came in meanwhile
+    }
+
+protected:
+    void run() {
+        while (!m_stop.loadAcquire()) {
+            if (!drain())
+                msleep(20);
+        }
+    }
+
+private:
+    bool drain() {
+        Entry entry;
+        bool any = false;
+
+        while (ring.pop(&entry)) {
+            QByteArray line = QDateTime::fromMSecsSinceEpoch(entry.time).toString("hh:mm:ss.zzz").toLatin1();
+            line += ' ';
+            line += LevelTags[entry.level];
+            line += ' ';
+            line += CategoryNames[entry.category];
+            line += ": ";
+            line += entry.text.trimmed().toLocal8Bit();  // QDebug leaves a space behind
+            line += '\n';
+            fwrite(line.constData(), 1, line.size(), m_out);
+            any = true;
+        }
+        int dropped = ring.takeDropped();
+        if (dropped > 0)
+            fprintf(m_out, "uqq log: %d lines dropped\n", dropped);
+        if (any)
+            fflush(m_out);
+        return any;
+    }
+
+    FILE *m_out;
+    QAtomicInt m_stop;
+};
+
+// set once by UQQLog::start(), read by every thread that logs
+QAtomicPointer<Writer> s_writer;
+
+void stopWriter() {
+    Writer *w = s_writer.fetchAndStoreAcquire(Q_NULLPTR);
+    if (!w) return;
+    w->stop();
+    delete w;
+}
+
+struct Configure {
+    Configure() { UQQLog::configure(qgetenv("UQQ_LOG")); }
+};
+Configure s_configure;
+
+} // namespace
+
+void UQQLog::setLevel(Category category, Level level) {
+    s_levels[category] = level;
+}
+
+void UQQLog::configure(const QByteArray &spec) {
+    static const char *const levelNames[] = { "debug", "info", "warning", "error", "off" };
+
+    foreach (const QByteArray &item, spec.toLower().split(',')) {
+        QList<QByteArray> pair = item.trimmed().split('=');
+        QByteArray name = pair.size() > 1 ? pair.at(0).trimmed() : QByteArray("*");
+        QByteArray value = pair.last().trimmed();
+        if (value.isEmpty()) continue;
+
+        int level = -1;
+        for (int i = Debug; i <= Off; i++) {
+            if (value == levelNames[i]) level = i;
+        }
+        if (level < 0) continue;
+
+        for (int i = 0; i < CategoryCount; i++) {
+            if (name == "*" || name == CategoryNames[i])
+                s_levels[i] = Level(level);
+        }
+    }
+}
+
+/*
+ * Starts the writer thread with the application's thread as the producer,
+ * whichever thread calls it. The client does so when it is created.
+ */
+void UQQLog::start() {
+    if (s_writer.loadAcquire()) return;
+
+    QCoreApplication *app = QCoreApplication::instance();
+    Writer *w = new Writer(app ? app->thread() : QThread::currentThread());
+    if (!s_writer.testAndSetOrdered(Q_NULLPTR, w)) {
+        delete w;   // another thread was first
+        return;
+    }
+    w->start(QThread::LowPriority);
+    qAddPostRoutine(stopWriter);
+}
+
+void UQQLog::write(Category category, Level level, const QString &text) {
+    Writer *w = s_writer.loadAcquire();
+    if (!w || QThread::currentThread() != w->m_producer) {
+        qDebug("%s: %s", CategoryNames[category], qPrintable(text));
+        return;
+    }
+
+    Entry entry;
+    entry.time = QDateTime::currentMSecsSinceEpoch();
+    entry.category = category;
+    entry.level = level;
+    entry.text = text;
+    w->ring.push(entry);
+}
+
+const char *UQQLog::categoryName(Category category) {
+    return CategoryNames[category];
+}
@@ -0,0 +1,101 @@
+#ifndef UQQLOG_H
+#define UQQLOG_H
+
+#include <QDebug>
+#include <QString>
+
+/*
+ * Levelled logging per category, written by a background thread.
+ *
+ *   uqqDebug(Poll) << "poll done." << retCode;
+ *
+ * A disabled line costs one array lookup, its arguments are not even
+ * evaluated, so they must not do anything the caller depends on. An
+ * enabled line is formatted with QDebug on the calling thread and put into
+ * a fixed ring, a writer thread takes it from there to stderr or
+ * UQQ_LOG_FILE. The GUI thread never waits for I/O: when the ring is full
+ * the line is dropped and counted.
+ *
+ * The ring has a single producer, the application's thread, which is where
+ * the client lives and calls start(). Lines from other threads, or from
+ * before start(), go to qDebug directly.
+ *
+ * Levels are read from UQQ_LOG, a level for all categories and/or
+ * category=level pairs, e.g. "debug" or "warning,poll=debug,net=info".
+ * The default is warning.
+ */
+class UQQLog
+{
+public:
+    enum Category {
+        General,
+        Net,
+        Login,
+        Poll,
+        Contact,
+        Group,
+        Message,
+        CategoryCount
+    };
+
+    enum Level {
+        Debug,
+        Info,
+        Warning,
+        Error,
+        Off
+    };
+
+    static bool enabled(Category category, Level level) {
+        return level >= s_levels[category];
+    }
+    static void setLevel(Category category, Level level);
+    static void configure(const QByteArray &spec);
+
+    static void start();
+    static void write(Category category, Level level, const QString &text);
+    static const char *categoryName(Category category);
+
+private:
+    static Level s_levels[CategoryCount];
+};
+
+/*
+ * One line, handed to UQQLog when it goes out of scope. The stream is
+ * declared last so it is flushed into the text before the line is written.
+ */
+class UQQLogLine
+{
+public:
+    UQQLogLine(UQQLog::Category category, UQQLog::Level level)
+        : m_line(category, level), m_stream(&m_line.text) {}
+
+    QDebug &stream() { return m_stream; }
+
+private:
+    struct Line {
+        Line(UQQLog::Category category, UQQLog::Level level)
+            : category(category), level(level) {}
+        ~Line() { UQQLog::write(category, level, text); }
+
+        UQQLog::Category category;
+        UQQLog::Level level;
+        QString text;
+    };
+
+    Line m_line;
+    QDebug m_stream;
+};
+
+// a loop rather than if/else, so an else after the line has nothing to bind to
+#define uqqLog(category, level) \
+    for (bool uqqEnabled = UQQLog::enabled(UQQLog::category, UQQLog::level); \
+         uqqEnabled; uqqEnabled = false) \
+        UQQLogLine(UQQLog::category, UQQLog::level).stream()
+
+#define uqqDebug(category) uqqLog(category, Debug)
+#define uqqInfo(category) uqqLog(category, Info)
+#define uqqWarning(category) uqqLog(category, Warning)
+#define uqqError(category) uqqLog(category, Error)
+
+#endif // UQQLOG_H
@@ -1,8 +1,9 @@
 #include "uqqmember.h"
 
 UQQMember::UQQMember(quint64 gid, const QString &uin, QObject *parent) :
-    QObject(parent), m_uin(uin), m_gid(gid)
+    QObject(parent), m_uin(uin), m_uinKey(uin.toULongLong()), m_gid(gid)
 {
+    m_history = Q_NULLPTR;
     setIsFriend(true);
     setVip(false);
     setVipLevel(0);
@@ -17,8 +18,13 @@ UQQMember::UQQMember(quint64 gid, const QString &uin, QObject *parent) :
 QString UQQMember::uin() const {
     return m_uin;
 }
+UQQUin UQQMember::uinKey() const {
+    return m_uinKey;
+}
+
 void UQQMember::setUin(QString uin) {
     m_uin = uin;
+    m_uinKey = uin.toULongLong();
 }
 
 quint64 UQQMember::gid() const {
@@ -183,23 +189,33 @@ UQQMember::Status UQQMember::statusIndex(const QString &s) {
     return si;
 }
 
-void UQQMember::addMessage(UQQMessage *message) {
-    m_messages.append(message);
+/*
+ * Most members never exchange a message, so the history is created on
+ * demand. A friend is one object wherever it shows up, a stranger has one
+ * per group with a session of its own, so its log is named by the group
+ * as well; histories sharing a log would read each other's records.
+ */
+UQQMessageHistory *UQQMember::history() {
+    if (!m_history) {
+        QString name = m_isFriend ? "member_" + m_uin
+                                  : QString("member_%1_%2").arg(m_gid).arg(m_uin);
+        m_history = new UQQMessageHistory(name, this);
+    }
+    return m_history;
+}
+
+void UQQMember::addMessage(const UQQMessage &message) {
+    history()->append(message);
     setMessageCount(messageCount() + 1);
     emit messageReceived();
 }
 
-QList<QObject *> UQQMember::messages(bool newMsg) {
-    QList<QObject *> results;
-    const QList<UQQMessage *> &messages =
-            newMsg ? m_messages.mid(m_messages.count() - messageCount()) : m_messages;
+QObject *UQQMember::messages() {
+    return history();
+}
 
-    foreach (UQQMessage *message, messages) {
-        results.append(message);
-    }
+void UQQMember::readMessages() {
     setMessageCount(0);
-
-    return results;
 }
 
 int UQQMember::messageCount() const {
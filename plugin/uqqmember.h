@@ -4,8 +4,15 @@
 #include <QObject>
 #include <QUrl>
 #include "uqqmessage.h"
+#include "uqqmessagehistory.h"
 #include "uqqmemberdetail.h"
 
+/*
+ * A uin as the server sends it, used as the key of every member hash.
+ * QML still sees the uin as a string.
+ */
+typedef quint64 UQQUin;
+
 class UQQMember : public QObject
 {
     Q_OBJECT
@@ -49,12 +56,14 @@ public:
     Q_PROPERTY(QString groupSig READ groupSig NOTIFY groupSigChanged)
 
     Q_PROPERTY(int messageCount READ messageCount NOTIFY messageCountChanged)
+    Q_PROPERTY(QObject *messages READ messages CONSTANT)
 
     Q_PROPERTY(UQQMemberDetail *detail READ detail NOTIFY detailChanged)
 
     explicit UQQMember(quint64 gid = 0, const QString &uin = "", QObject *parent = 0);
 
     QString uin() const;
+    UQQUin uinKey() const;
     void setUin(QString uin);
     quint64 gid() const;
     void setGid(quint64 gid);
@@ -92,11 +101,13 @@ public:
     int messageCount() const;
     void setMessageCount(int messageCount);
 
-    void addMessage(UQQMessage *message);
-    Q_INVOKABLE QList<QObject *> messages(bool newMsg = false);
+    void addMessage(const UQQMessage &message);
+    QObject *messages();
+    Q_INVOKABLE void readMessages();
 
 private:
     QString m_uin;
+    UQQUin m_uinKey;
     quint64 m_gid;
     bool m_isFriend;
     QString m_card;
@@ -115,7 +126,9 @@ private:
 
     UQQMemberDetail *m_detail;
 
-    QList<UQQMessage *> m_messages;
+    UQQMessageHistory *history();
+
+    UQQMessageHistory *m_history;
     int m_messageCount;
 
 signals:
@@ -15,6 +15,8 @@ UQQMemberDetail::UQQMemberDetail(QObject *parent) :
     setConstel(0);
     setGender(Secret);
     setBirthday(QDateTime::currentDateTime());
+    for (int i = 0; i < PartCount; i++)
+        m_fetchedAt[i] = 0;
 }
 
 quint64 UQQMemberDetail::account() const {
@@ -255,3 +257,24 @@ void UQQMemberDetail::setToken(const QString &token) {
         emit tokenChanged();
     }
 }
+
+// seconds
+qint64 UQQMemberDetail::maxAge(Part part) {
+    switch (part) {
+    case LongNickPart:
+        return 10 * 60;
+    case InfoPart:
+        return 60 * 60;
+    default:    // the level and the account hardly change
+        return 24 * 60 * 60;
+    }
+}
+
+bool UQQMemberDetail::isFresh(Part part) const {
+    if (m_fetchedAt[part] == 0) return false;
+    return QDateTime::currentMSecsSinceEpoch() / 1000 - m_fetchedAt[part] < maxAge(part);
+}
+
+void UQQMemberDetail::touch(Part part) {
+    m_fetchedAt[part] = QDateTime::currentMSecsSinceEpoch() / 1000;
+}
@@ -17,6 +17,15 @@ public:
 
     static Gender genderIndex(const QString &s);
 
+    // the separately fetched parts, each is trusted for a while once fetched
+    enum Part {
+        LongNickPart,
+        LevelPart,
+        InfoPart,
+        AccountPart,
+        PartCount
+    };
+
     Q_PROPERTY(quint64 account READ account NOTIFY accountChanged)
 
     Q_PROPERTY(int level READ level NOTIFY levelChanged)
@@ -93,6 +102,9 @@ public:
     void setGender(int gender);
     QString token() const;
     void setToken(const QString &token);
+
+    bool isFresh(Part part) const;
+    void touch(Part part);
     
 signals:
     void accountChanged();
@@ -123,6 +135,10 @@ signals:
 public slots:
 
 private:
+    static qint64 maxAge(Part part);
+
+    qint64 m_fetchedAt[PartCount];
+
     quint64 m_account;
 
     int m_level;
@@ -0,0 +1,29 @@
+#include "uqqmembermodel.h"
+
+UQQMemberModel::UQQMemberModel(const QList<UQQMember *> &members, QObject *parent)
+    : QAbstractListModel(parent), m_members(members) {
+}
+
+int UQQMemberModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) return 0;
+    return m_members.size();
+}
+
+QVariant UQQMemberModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= m_members.size()) return QVariant();
+
+    if (role == MemberRole)
+        return QVariant::fromValue(static_cast<QObject *>(m_members.at(index.row())));
+    return QVariant();
+}
+
+QHash<int, QByteArray> UQQMemberModel::roleNames() const {
+    QHash<int, QByteArray> roles;
+    roles[MemberRole] = "modelData";
+    return roles;
+}
+
+QObject *UQQMemberModel::get(int row) const {
+    if (row < 0 || row >= m_members.size()) return Q_NULLPTR;
+    return m_members.at(row);
+}
@@ -0,0 +1,37 @@
+#ifndef UQQMEMBERMODEL_H
+#define UQQMEMBERMODEL_H
+
+#include <QAbstractListModel>
+#include <QList>
+#include "uqqmember.h"
+
+/*
+ * A live view over the sorted members of one category.
+ *
+ * The model does not copy the list, UQQCategory updates it in place and
+ * brackets every insert, remove and move with the model notifications.
+ * Delegates get the member itself as modelData.
+ */
+class UQQMemberModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum MemberRoles {
+        MemberRole = Qt::UserRole + 1
+    };
+
+    explicit UQQMemberModel(const QList<UQQMember *> &members, QObject *parent = 0);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QHash<int, QByteArray> roleNames() const;
+
+    Q_INVOKABLE QObject *get(int row) const;
+
+private:
+    friend class UQQCategory;
+
+    const QList<UQQMember *> &m_members;
+};
+
+#endif // UQQMEMBERMODEL_H
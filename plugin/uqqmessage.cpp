@@ -1,12 +1,15 @@
 #include "uqqmessage.h"
+#include "uqqcontentcodec.h"
 
-UQQMessage::UQQMessage(QObject *parent) :
-    QObject(parent)
-{
+UQQMessage::UQQMessage() {
+    setSrc(0);
+    setDst(0);
+    setTimestamp(0);
     setId(0);
     setId2(0);
     setType(0);
-    setReplyIP(0);
+    setState(NoState);
+    setFontStyle(0);
 }
 
 int UQQMessage::id() const {
@@ -30,10 +33,10 @@ void UQQMessage::setType(int type) {
     m_type = type;
 }
 
-QString UQQMessage::src() const {
+quint64 UQQMessage::src() const {
     return m_srcUin;
 }
-void UQQMessage::setSrc(const QString &src) {
+void UQQMessage::setSrc(quint64 src) {
     m_srcUin = src;
 }
 
@@ -44,30 +47,61 @@ void UQQMessage::setName(const QString &name) {
     m_name = name;
 }
 
-QString UQQMessage::dst() const {
+quint64 UQQMessage::dst() const {
     return m_dstUin;
 }
-void UQQMessage::setDst(const QString &dst) {
+void UQQMessage::setDst(quint64 dst) {
     m_dstUin = dst;
 }
 
 QDateTime UQQMessage::time() const {
-    return m_time;
+    return QDateTime::fromTime_t(m_time);
 }
 void UQQMessage::setTime(const QDateTime &time) {
-    m_time = time;
+    m_time = time.toTime_t();
 }
 
-quint32 UQQMessage::replyIP() const {
-    return m_replyIP;
+quint32 UQQMessage::timestamp() const {
+    return m_time;
 }
-void UQQMessage::setReplyIP(quint32 replyIP) {
-    m_replyIP = replyIP;
+void UQQMessage::setTimestamp(quint32 timestamp) {
+    m_time = timestamp;
 }
 
 QString UQQMessage::content() const {
-    return m_content;
+    if (m_segments.size() == 1 && m_segments.first().type == UQQMessageSegment::TextSegment)
+        return m_segments.first().text;     // shared, no copy
+
+    QString text;
+    foreach (const UQQMessageSegment &segment, m_segments) {
+        if (segment.type == UQQMessageSegment::FaceSegment)
+            text.append(QLatin1String("[face")).append(QString::number(segment.face)).append(QLatin1Char(']'));
+        else
+            text.append(segment.text);
+    }
+    return text;
 }
 void UQQMessage::setContent(const QString &content) {
-    m_content = content;
+    m_segments = UQQContentCodec::split(content);
+}
+
+const QVector<UQQMessageSegment> &UQQMessage::segments() const {
+    return m_segments;
+}
+void UQQMessage::setSegments(const QVector<UQQMessageSegment> &segments) {
+    m_segments = segments;
+}
+
+int UQQMessage::fontStyle() const {
+    return m_fontStyle;
+}
+void UQQMessage::setFontStyle(int style) {
+    m_fontStyle = quint8(style);
+}
+
+int UQQMessage::state() const {
+    return m_state;
+}
+void UQQMessage::setState(int state) {
+    m_state = state;
 }
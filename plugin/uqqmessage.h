@@ -1,25 +1,58 @@
 #ifndef UQQMESSAGE_H
 #define UQQMESSAGE_H
 
-#include <QObject>
+#include <QString>
 #include <QDateTime>
+#include <QVector>
 
-class UQQMessage : public QObject
+// a run of text or a face, in display order
+struct UQQMessageSegment
+{
+    enum Type {
+        TextSegment,
+        FaceSegment
+    };
+
+    UQQMessageSegment() : type(TextSegment), face(0) {}
+
+    int type;
+    int face;
+    QString text;
+};
+
+Q_DECLARE_TYPEINFO(UQQMessageSegment, Q_MOVABLE_TYPE);
+
+/*
+ * A chat message, stored by value in the message history.
+ * The uins are kept as integers and the time as seconds since the epoch.
+ * The content is kept as segments only, content() gives its text form
+ * ("[faceN]" for faces). Of the font only the style is kept, the view
+ * uses nothing else.
+ */
+class UQQMessage
 {
-    Q_OBJECT
 public:
     enum MessageType {
         TypeSend = 0x1000
     };
 
+    // of sent messages, received ones stay in NoState
+    enum DeliveryState {
+        NoState,
+        QueuedState,
+        SendingState,
+        SentState,
+        FailedState
+    };
 
-    Q_PROPERTY(QString src READ src)
-    Q_PROPERTY(QString name READ name)
-    Q_PROPERTY(QDateTime time READ time)
-    Q_PROPERTY(QString content READ content)
-    Q_PROPERTY(int type READ type)
+    // the style of the font entry
+    enum FontStyle {
+        Bold = 0x1,
+        Italic = 0x2,
+        Underline = 0x4
+    };
 
-    explicit UQQMessage(QObject *parent = 0);
+    UQQMessage();
 
     int id() const;
     void setId(int id);
@@ -27,40 +60,38 @@ public:
     void setId2(int id2);
     int type() const;
     void setType(int type);
-    QString src() const;
-    void setSrc(const QString &src);
+    quint64 src() const;
+    void setSrc(quint64 src);
     QString name() const;
     void setName(const QString &name);
-    QString dst() const;
-    void setDst(const QString &dst);
+    quint64 dst() const;
+    void setDst(quint64 dst);
     QDateTime time() const;
     void setTime(const QDateTime &time);
-    quint32 replyIP() const;
-    void setReplyIP(quint32 replyIP);
+    quint32 timestamp() const;
+    void setTimestamp(quint32 timestamp);
     QString content() const;
     void setContent(const QString &content);
+    const QVector<UQQMessageSegment> &segments() const;
+    void setSegments(const QVector<UQQMessageSegment> &segments);
+    int fontStyle() const;
+    void setFontStyle(int style);
+    int state() const;
+    void setState(int state);
 
-signals:
-    
-public slots:
-    
 private:
-    int     m_id;
-    int     m_id2;
-    int     m_type;
-    QString m_srcUin;
-    QString m_dstUin;
+    quint64 m_srcUin;
+    quint64 m_dstUin;
+    quint32 m_time;
+    qint32  m_type;
+    qint32  m_id;
+    qint32  m_id2;
+    qint32  m_state;
+    quint8  m_fontStyle;
     QString m_name;
-    QDateTime m_time;
-    quint32 m_replyIP;
-    QString m_content;
-
-    int m_fontSize;
-    QString m_fontColor;
-    QString m_fontName;
-    bool    m_boldStyle;
-    bool    m_italicStyle;
-    bool    m_underlineStyle;
+    QVector<UQQMessageSegment> m_segments;
 };
 
+Q_DECLARE_TYPEINFO(UQQMessage, Q_MOVABLE_TYPE);
+
 #endif // UQQMESSAGE_H
@@ -0,0 +1,296 @@
+#include "uqqmessagehistory.h"
+#include "uqqlog.h"
+#include <QFile>
+#include <QDataStream>
+
+QString UQQMessageHistory::s_path;
+qint64 UQQMessageHistory::s_bytes = 0;
+
+static void writeMessage(QDataStream &out, const UQQMessage &message) {
+    out << message.src() << message.dst() << message.timestamp()
+        << qint32(message.type()) << qint32(message.id()) << qint32(message.id2())
+        << message.name() << message.content();
+}
+
+static void readMessage(QDataStream &in, UQQMessage *message) {
+    quint64 src, dst;
+    quint32 time;
+    qint32 type, id, id2;
+    QString name, content;
+
+    in >> src >> dst >> time >> type >> id >> id2 >> name >> content;
+    message->setSrc(src);
+    message->setDst(dst);
+    message->setTimestamp(time);
+    message->setType(type);
+    message->setId(id);
+    message->setId2(id2);
+    message->setName(name);
+    message->setContent(content);
+}
+
+UQQMessageHistory::UQQMessageHistory(const QString &name, QObject *parent, int capacity)
+    : QAbstractListModel(parent), m_name(name) {
+    m_ring.resize(qMax(capacity, 1));
+    m_head = 0;
+    m_count = 0;
+    m_indexed = false;
+    m_loadedFrom = 0;
+    m_bytes = 0;
+}
+
+UQQMessageHistory::~UQQMessageHistory() {
+    addBytes(-m_bytes);
+}
+
+/*
+ * The directory spilled messages are written to, set once the user path
+ * is known. Without it the oldest messages are simply dropped.
+ */
+void UQQMessageHistory::setPath(const QString &path) {
+    s_path = path;
+}
+
+// an estimate of the memory the messages of all histories take
+qint64 UQQMessageHistory::totalBytes() {
+    return s_bytes;
+}
+
+qint64 UQQMessageHistory::messageBytes(const UQQMessage &message) {
+    qint64 chars = message.name().size();
+    foreach (const UQQMessageSegment &segment, message.segments())
+        chars += segment.text.size();
+    return sizeof(UQQMessage) + chars * sizeof(QChar) +
+            message.segments().size() * sizeof(UQQMessageSegment);
+}
+
+void UQQMessageHistory::addBytes(qint64 bytes) {
+    m_bytes += bytes;
+    s_bytes += bytes;
+}
+
+int UQQMessageHistory::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) return 0;
+    return m_loaded.size() + m_count;
+}
+
+QVariant UQQMessageHistory::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= rowCount()) return QVariant();
+
+    const UQQMessage &message = at(index.row());
+    switch (role) {
+    case NameRole:
+        if (message.name().isEmpty())
+            return QString::number(message.src());
+        return message.name();
+    case TimeRole:
+        return message.time();
+    case ContentRole:
+        return message.content();
+    case TypeRole:
+        return message.type();
+    case SrcRole:
+        return QString::number(message.src());
+    case SegmentsRole:
+        return segmentList(message);
+    case FontRole:
+        return fontMap(message);
+    case StateRole:
+        return message.state();
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> UQQMessageHistory::roleNames() const {
+    QHash<int, QByteArray> roles;
+    roles[NameRole] = "name";
+    roles[TimeRole] = "time";
+    roles[ContentRole] = "content";
+    roles[TypeRole] = "type";
+    roles[SrcRole] = "src";
+    roles[SegmentsRole] = "segments";
+    roles[FontRole] = "font";
+    roles[StateRole] = "state";
+    return roles;
+}
+
+/*
+ * [{"text":"hello"},{"face":14}], the view lays the segments out as they
+ * are.
+ */
+QVariantList UQQMessageHistory::segmentList(const UQQMessage &message) {
+    const QVector<UQQMessageSegment> &segments = message.segments();
+
+    QVariantList list;
+    list.reserve(segments.size());
+    foreach (const UQQMessageSegment &segment, segments) {
+        QVariantMap m;
+        if (segment.type == UQQMessageSegment::FaceSegment)
+            m.insert("face", segment.face);
+        else
+            m.insert("text", segment.text);
+        list.append(m);
+    }
+    return list;
+}
+
+QVariant UQQMessageHistory::fontMap(const UQQMessage &message) {
+    int style = message.fontStyle();
+    if (!style) return QVariant();
+
+    QVariantMap m;
+    m.insert("bold", bool(style & UQQMessage::Bold));
+    m.insert("italic", bool(style & UQQMessage::Italic));
+    m.insert("underline", bool(style & UQQMessage::Underline));
+    return m;
+}
+
+// the number of messages held in memory, paged in history aside
+int UQQMessageHistory::count() const {
+    return m_count;
+}
+
+const UQQMessage &UQQMessageHistory::at(int row) const {
+    if (row < m_loaded.size())
+        return m_loaded.at(row);
+    return m_ring.at((m_head + row - m_loaded.size()) % m_ring.size());
+}
+
+UQQMessage &UQQMessageHistory::message(int row) {
+    if (row < m_loaded.size())
+        return m_loaded[row];
+    return m_ring[(m_head + row - m_loaded.size()) % m_ring.size()];
+}
+
+void UQQMessageHistory::append(const UQQMessage &message) {
+    if (m_count == m_ring.size()) { // full, the oldest message goes to disk
+        const UQQMessage &oldest = m_ring.at(m_head);
+        spill(oldest);
+        if (m_loaded.isEmpty()) {
+            addBytes(-messageBytes(oldest));
+            beginRemoveRows(QModelIndex(), 0, 0);
+            m_head = (m_head + 1) % m_ring.size();
+            m_count--;
+            endRemoveRows();
+        } else {    // the row stays, it only moves into the paged in part
+            m_loaded.append(oldest);
+            m_head = (m_head + 1) % m_ring.size();
+            m_count--;
+        }
+    }
+
+    int row = rowCount();
+    beginInsertRows(QModelIndex(), row, row);
+    m_ring[(m_head + m_count) % m_ring.size()] = message;
+    m_count++;
+    addBytes(messageBytes(message));
+    endInsertRows();
+}
+
+void UQQMessageHistory::setName(int row, const QString &name) {
+    if (row < 0 || row >= rowCount()) return;
+
+    message(row).setName(name);
+    QModelIndex changed = index(row);
+    emit dataChanged(changed, changed, QVector<int>() << NameRole);
+}
+
+// the delivery state of the sent message msgId, looked up from the newest
+void UQQMessageHistory::setState(int msgId, int state) {
+    for (int row = rowCount() - 1; row >= 0; row--) {
+        UQQMessage &m = message(row);
+        if (m.state() == UQQMessage::NoState || m.id() != msgId) continue;
+
+        m.setState(state);
+        QModelIndex changed = index(row);
+        emit dataChanged(changed, changed, QVector<int>() << StateRole);
+        return;
+    }
+}
+
+/*
+ * Reads the n spilled messages preceding the ones already shown back from
+ * the log and inserts them at the top. Returns the number of messages read.
+ */
+int UQQMessageHistory::load(int n) {
+    buildIndex();
+
+    int to = m_loaded.isEmpty() ? m_offsets.size() : m_loadedFrom;
+    int from = qMax(0, to - n);
+    if (from >= to) return 0;
+
+    QFile file(fileName());
+    if (!file.open(QIODevice::ReadOnly)) return 0;
+    file.seek(m_offsets.at(from));
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    QVector<UQQMessage> page;
+    page.reserve(to - from);
+    for (int i = from; i < to; i++) {
+        UQQMessage message;
+        readMessage(in, &message);
+        if (in.status() != QDataStream::Ok) break;
+        page.append(message);
+        addBytes(messageBytes(message));
+    }
+    if (page.isEmpty()) return 0;
+
+    beginInsertRows(QModelIndex(), 0, page.size() - 1);
+    m_loaded = page + m_loaded;
+    m_loadedFrom = from;
+    endInsertRows();
+    return page.size();
+}
+
+// drops the paged in history once the conversation is closed
+void UQQMessageHistory::release() {
+    if (m_loaded.isEmpty()) return;
+
+    foreach (const UQQMessage &message, m_loaded)
+        addBytes(-messageBytes(message));
+
+    beginRemoveRows(QModelIndex(), 0, m_loaded.size() - 1);
+    m_loaded.clear();
+    m_loaded.squeeze();
+    endRemoveRows();
+}
+
+QString UQQMessageHistory::fileName() const {
+    return s_path + "/" + m_name + ".log";
+}
+
+void UQQMessageHistory::spill(const UQQMessage &message) {
+    if (s_path.isEmpty()) return;
+
+    QFile file(fileName());
+    if (file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qint64 offset = file.size();
+        QDataStream out(&file);
+        out.setVersion(QDataStream::Qt_5_0);
+        writeMessage(out, message);
+        if (m_indexed)
+            m_offsets.append(offset);
+    } else {
+        uqqWarning(Message) << "Error: open history" << file.fileName();
+    }
+}
+
+// the log may hold messages of earlier sessions, index it on first use
+void UQQMessageHistory::buildIndex() {
+    if (m_indexed) return;
+    m_indexed = true;
+
+    QFile file(fileName());
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    while (!in.atEnd()) {
+        qint64 offset = file.pos();
+        UQQMessage message;
+        readMessage(in, &message);
+        if (in.status() != QDataStream::Ok) break;
+        m_offsets.append(offset);
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef UQQMESSAGEHISTORY_H
+#define UQQMESSAGEHISTORY_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include <QString>
+#include <QVariant>
+#include "uqqmessage.h"
+
+/*
+ * The message history of one conversation, exposed to QML as a list model.
+ *
+ * Only the newest messages are kept in a fixed-capacity ring, older ones are
+ * appended to a log file under the user path. Pages of the log are read back
+ * on demand with load() and are shown ahead of the ring until release().
+ */
+class UQQMessageHistory : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_ENUMS(DeliveryState)
+public:
+    // UQQMessage::DeliveryState for QML, the values of the state role
+    enum DeliveryState {
+        NoState = UQQMessage::NoState,
+        QueuedState = UQQMessage::QueuedState,
+        SendingState = UQQMessage::SendingState,
+        SentState = UQQMessage::SentState,
+        FailedState = UQQMessage::FailedState
+    };
+
+    enum MessageRoles {
+        NameRole = Qt::UserRole + 1,
+        TimeRole,
+        ContentRole,
+        TypeRole,
+        SrcRole,
+        SegmentsRole,
+        FontRole,
+        StateRole
+    };
+
+    enum {
+        DefaultCapacity = 100,
+        PageSize = 50
+    };
+
+    explicit UQQMessageHistory(const QString &name, QObject *parent = 0,
+                               int capacity = DefaultCapacity);
+    ~UQQMessageHistory();
+
+    static void setPath(const QString &path);
+    static qint64 totalBytes();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QHash<int, QByteArray> roleNames() const;
+
+    int count() const;
+    const UQQMessage &at(int row) const;
+    void append(const UQQMessage &message);
+    void setName(int row, const QString &name);
+    void setState(int msgId, int state);
+
+    Q_INVOKABLE int load(int n = PageSize);
+    Q_INVOKABLE void release();
+
+private:
+    UQQMessage &message(int row);
+    static QVariantList segmentList(const UQQMessage &message);
+    static QVariant fontMap(const UQQMessage &message);
+    QString fileName() const;
+    void spill(const UQQMessage &message);
+    void buildIndex();
+    static qint64 messageBytes(const UQQMessage &message);
+    void addBytes(qint64 bytes);
+
+    static QString s_path;
+    static qint64 s_bytes;      // held by all histories
+
+    QString m_name;
+    QVector<UQQMessage> m_ring;
+    int m_head;
+    int m_count;
+
+    QVector<qint64> m_offsets;  // record offsets in the log file, oldest first
+    bool m_indexed;
+    QVector<UQQMessage> m_loaded;
+    int m_loadedFrom;           // log record of the first loaded message
+    qint64 m_bytes;
+};
+
+#endif // UQQMESSAGEHISTORY_H
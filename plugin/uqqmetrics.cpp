@@ -0,0 +1,111 @@
+#include "uqqmetrics.h"
+
+UQQHistogram::UQQHistogram() {
+    for (int i = 0; i < Buckets; i++)
+        m_buckets[i] = 0;
+    m_count = 0;
+    m_sum = 0;
+    m_max = 0;
+}
+
+void UQQHistogram::record(qint64 us) {
+    if (us < 0) us = 0;
+
+    int bucket = 0;
+    while (bucket < Buckets - 1 && (Q_INT64_C(1) << bucket) <= us)
+        bucket++;
+    m_buckets[bucket]++;
+    m_count++;
+    m_sum += us;
+    m_max = qMax(m_max, us);
+}
+
+qint64 UQQHistogram::count() const {
+    return m_count;
+}
+
+qint64 UQQHistogram::percentile(int p) const {
+    if (m_count == 0) return 0;
+
+    qint64 rank = (m_count * p + 99) / 100;
+    qint64 seen = 0;
+    for (int i = 0; i < Buckets; i++) {
+        seen += m_buckets[i];
+        if (seen >= rank)
+            return qMin(Q_INT64_C(1) << i, m_max);
+    }
+    return m_max;
+}
+
+QVariantMap UQQHistogram::toMap() const {
+    QVariantMap m;
+    m.insert("count", m_count);
+    m.insert("meanUs", m_count ? m_sum / m_count : 0);
+    m.insert("p50Us", percentile(50));
+    m.insert("p90Us", percentile(90));
+    m.insert("p99Us", percentile(99));
+    m.insert("maxUs", m_max);
+    return m;
+}
+
+UQQMetrics::UQQMetrics() {
+    m_clock.start();
+}
+
+qint64 UQQMetrics::elapsed() const {
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+void UQQMetrics::sent(int action) {
+    m_actions[action].requests++;
+}
+
+void UQQMetrics::coalesced(int action) {
+    m_actions[action].coalesced++;
+}
+
+void UQQMetrics::dropped(int action) {
+    m_actions[action].dropped++;
+}
+
+void UQQMetrics::replied(int action, qint64 latency, qint64 handling) {
+    ActionStats &stats = m_actions[action];
+    stats.replies++;
+    stats.latency.record(latency);
+    stats.handling.record(handling);
+}
+
+void UQQMetrics::failed(int action, qint64 latency) {
+    ActionStats &stats = m_actions[action];
+    stats.errors++;
+    stats.latency.record(latency);
+}
+
+void UQQMetrics::parsed(qint64 us) {
+    m_parse.record(us);
+}
+
+QVariantMap UQQMetrics::toMap(const QMetaEnum &actions) const {
+    QVariantMap actionMap;
+    QHash<int, ActionStats>::ConstIterator iter;
+    for (iter = m_actions.constBegin(); iter != m_actions.constEnd(); ++iter) {
+        const ActionStats &stats = iter.value();
+        QVariantMap m;
+        m.insert("requests", stats.requests);
+        m.insert("replies", stats.replies);
+        m.insert("errors", stats.errors);
+        m.insert("coalesced", stats.coalesced);
+        m.insert("dropped", stats.dropped);
+        m.insert("latency", stats.latency.toMap());
+        m.insert("handling", stats.handling.toMap());
+
+        const char *name = actions.valueToKey(iter.key());
+        actionMap.insert(name ? QString(name) : QString::number(iter.key()), m);
+    }
+
+    QVariantMap m;
+    m.insert("uptimeMs", elapsed() / 1000);
+    m.insert("actions", actionMap);
+    m.insert("responseParse", m_parse.toMap());
+    return m;
+}
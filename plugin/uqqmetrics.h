@@ -0,0 +1,75 @@
+#ifndef UQQMETRICS_H
+#define UQQMETRICS_H
+
+#include <QHash>
+#include <QVariantMap>
+#include <QElapsedTimer>
+#include <QMetaEnum>
+
+/*
+ * Durations in microseconds in power of two buckets, bucket i counts the
+ * values below 2^i us. Percentiles are the upper bound of their bucket,
+ * good to a factor of two and cheap enough to record on every reply.
+ */
+class UQQHistogram
+{
+public:
+    enum { Buckets = 32 };
+
+    UQQHistogram();
+
+    void record(qint64 us);
+    qint64 count() const;
+    qint64 percentile(int p) const;
+    QVariantMap toMap() const;
+
+private:
+    qint64 m_buckets[Buckets];
+    qint64 m_count;
+    qint64 m_sum;
+    qint64 m_max;
+};
+
+/*
+ * Counters and histograms of the client's hot paths: per action the
+ * requests sent by the scheduler, the replies and errors, the requests it
+ * coalesced into one in flight or dropped as duplicates, the time from
+ * asking (queueing in the scheduler included) to onFinished and the time
+ * its handler took, and the time spent parsing reply JSON. Requests sent
+ * are replies plus errors plus the ones in flight.
+ */
+class UQQMetrics
+{
+public:
+    UQQMetrics();
+
+    qint64 elapsed() const;     // us since start, the clock of all records
+
+    void sent(int action);
+    void coalesced(int action);
+    void dropped(int action);
+    void replied(int action, qint64 latency, qint64 handling);
+    void failed(int action, qint64 latency);
+    void parsed(qint64 us);
+
+    QVariantMap toMap(const QMetaEnum &actions) const;
+
+private:
+    struct ActionStats {
+        ActionStats() : requests(0), replies(0), errors(0), coalesced(0), dropped(0) {}
+
+        qint64 requests;
+        qint64 replies;
+        qint64 errors;
+        qint64 coalesced;
+        qint64 dropped;
+        UQQHistogram latency;
+        UQQHistogram handling;
+    };
+
+    QElapsedTimer m_clock;
+    QHash<int, ActionStats> m_actions;
+    UQQHistogram m_parse;
+};
+
+#endif // UQQMETRICS_H
@@ -0,0 +1,239 @@
+#include "uqqnetworkmanager.h"
+#include "uqqlog.h"
+
+// the query items telling lookups of the same path apart
+static const char *const TargetItems[] = { "gcode", "tuin", "uin" };
+static const int TargetItemCount = sizeof(TargetItems) / sizeof(TargetItems[0]);
+
+UQQNetworkManager::UQQNetworkManager(QObject *parent)
+    : QNetworkAccessManager(parent) {
+    m_mode = LiveMode;
+    m_speed = 1.0;
+    m_recorded = 0;
+    m_clock.start();
+
+    QByteArray mode = qgetenv("UQQ_TRANSPORT");
+    QString dir = QString::fromLocal8Bit(qgetenv("UQQ_TRANSPORT_DIR"));
+    if (dir.isEmpty())
+        dir = "recording";
+    bool ok;
+    double speed = qgetenv("UQQ_REPLAY_SPEED").toDouble(&ok);
+    if (!ok) speed = 1.0;
+
+    if (mode == "record")
+        setMode(RecordMode, dir, speed);
+    else if (mode == "replay")
+        setMode(ReplayMode, dir, speed);
+    else if (!mode.isEmpty() && mode != "live")
+        uqqWarning(Net) << "UQQ_TRANSPORT: unknown mode" << mode;
+}
+
+UQQNetworkManager::Mode UQQNetworkManager::mode() const {
+    return m_mode;
+}
+
+void UQQNetworkManager::setMode(Mode mode, const QString &dir, double speed) {
+    m_mode = mode;
+    m_dir = QDir(dir);
+    m_speed = speed;
+    m_entries.clear();
+
+    if (mode == RecordMode) {
+        if (!m_dir.mkpath(".")) {
+            uqqWarning(Net) << "transport: can not create" << dir;
+            m_mode = LiveMode;
+            return;
+        }
+        QFile::remove(m_dir.filePath("manifest.json"));
+        m_recorded = 0;
+    } else if (mode == ReplayMode && !loadManifest()) {
+        uqqWarning(Net) << "transport: nothing to replay in" << dir;
+    }
+    uqqDebug(Net) << "transport:" << mode << dir;
+}
+
+// "gcode=42", "tuin=1234&uin=1234" or empty, the other items change per request
+QString UQQNetworkManager::targetKey(const QUrl &url) {
+    QUrlQuery query(url);
+    QStringList items;
+    for (int i = 0; i < TargetItemCount; i++) {
+        if (query.hasQueryItem(TargetItems[i]))
+            items.append(QString("%1=%2").arg(TargetItems[i], query.queryItemValue(TargetItems[i])));
+    }
+    return items.join("&");
+}
+
+/*
+ * manifest.json holds one object per line:
+ * {"path":"/channel/poll2","file":"0007.txt","status":200,"latency":812,"cookies":[...]}
+ * optionally with the "query" of targetKey() the request has to match.
+ */
+bool UQQNetworkManager::loadManifest() {
+    QFile file(m_dir.filePath("manifest.json"));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine().trimmed();
+        if (line.isEmpty()) continue;
+
+        QJsonObject obj = QJsonDocument::fromJson(line).object();
+        Entry entry;
+        entry.file = obj.value("file").toString();
+        entry.query = obj.value("query").toString();
+        entry.status = obj.value("status").toDouble(200);
+        entry.latency = obj.value("latency").toDouble(0);
+        foreach (const QJsonValue &cookie, obj.value("cookies").toArray())
+            entry.cookies.append(cookie.toString().toUtf8());
+        m_entries[obj.value("path").toString()].append(entry);
+    }
+    return !m_entries.isEmpty();
+}
+
+QNetworkReply *UQQNetworkManager::createRequest(Operation op, const QNetworkRequest &request,
+                                                QIODevice *outgoingData) {
+    if (m_mode == ReplayMode)
+        return replay(op, request);
+
+    QNetworkReply *reply = QNetworkAccessManager::createRequest(op, request, outgoingData);
+    if (m_mode == RecordMode) {
+        // connected before the manager's own slot, the body is still unread
+        m_startTimes.insert(reply, m_clock.elapsed());
+        connect(reply, SIGNAL(finished()), this, SLOT(onRecordFinished()));
+    }
+    return reply;
+}
+
+void UQQNetworkManager::onRecordFinished() {
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (!reply) return;
+    qint64 latency = m_clock.elapsed() - m_startTimes.take(reply);
+    if (reply->error() != QNetworkReply::NoError) return;
+
+    QString name = QString("%1.txt").arg(++m_recorded, 4, 10, QChar('0'));
+    QFile body(m_dir.filePath(name));
+    if (!body.open(QIODevice::WriteOnly)) return;
+    body.write(reply->peek(reply->bytesAvailable()));
+    body.close();
+
+    QJsonArray cookies;
+    QVariant header = reply->header(QNetworkRequest::SetCookieHeader);
+    foreach (const QNetworkCookie &cookie, qvariant_cast<QList<QNetworkCookie> >(header))
+        cookies.append(QString::fromUtf8(cookie.toRawForm()));
+
+    QJsonObject obj;
+    obj.insert("path", reply->url().path());
+    QString key = targetKey(reply->request().url());
+    if (!key.isEmpty())
+        obj.insert("query", key);
+    obj.insert("file", name);
+    obj.insert("status", reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt());
+    obj.insert("latency", double(latency));
+    obj.insert("cookies", cookies);
+
+    QFile manifest(m_dir.filePath("manifest.json"));
+    if (!manifest.open(QIODevice::WriteOnly | QIODevice::Append)) return;
+    manifest.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    manifest.write("\n");
+}
+
+QNetworkReply *UQQNetworkManager::replay(Operation op, const QNetworkRequest &request) {
+    UQQReplayReply *reply = new UQQReplayReply(op, request, this);
+
+    QHash<QString, QList<Entry> >::Iterator iter = m_entries.find(request.url().path());
+    int index = -1;
+    if (iter != m_entries.end()) {
+        QString key = targetKey(request.url());
+        for (int i = 0; i < iter.value().size() && index < 0; i++) {
+            const QString &q = iter.value().at(i).query;
+            if (q.isEmpty() || q == key)
+                index = i;
+        }
+    }
+    if (index < 0) {
+        reply->fail(QNetworkReply::ContentNotFoundError, "no recording left", 0);
+        return reply;
+    }
+
+    Entry entry = iter.value().takeAt(index);
+    int delay = m_speed > 0 ? int(entry.latency / m_speed) : 0;
+
+    QFile file(m_dir.filePath(entry.file));
+    if (!file.open(QIODevice::ReadOnly)) {
+        reply->fail(QNetworkReply::ContentNotFoundError, file.errorString(), delay);
+        return reply;
+    }
+    // the client reads ptwebqq & co from the jar
+    foreach (const QByteArray &raw, entry.cookies)
+        cookieJar()->setCookiesFromUrl(QNetworkCookie::parseCookies(raw), request.url());
+
+    reply->serve(entry.status, file.readAll(), delay);
+    return reply;
+}
+
+UQQReplayReply::UQQReplayReply(QNetworkAccessManager::Operation op, const QNetworkRequest &request,
+                               QObject *parent)
+    : QNetworkReply(parent) {
+    m_offset = 0;
+    m_error = NoError;
+    m_done = false;
+
+    setRequest(request);
+    setUrl(request.url());
+    setOperation(op);
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+void UQQReplayReply::serve(int status, const QByteArray &data, int delay) {
+    m_data = data;
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, status);
+    setHeader(QNetworkRequest::ContentLengthHeader, data.size());
+    QTimer::singleShot(delay, this, SLOT(deliver()));
+}
+
+void UQQReplayReply::fail(NetworkError error, const QString &message, int delay) {
+    m_error = error;
+    m_errorString = message;
+    QTimer::singleShot(delay, this, SLOT(deliver()));
+}
+
+// finished is always emitted from the event loop, as for a real reply
+void UQQReplayReply::deliver() {
+    if (m_done) return;
+    m_done = true;
+
+    if (m_error != NoError) {
+        setError(m_error, m_errorString);
+        emit error(m_error);
+    } else {
+        emit metaDataChanged();
+        if (!m_data.isEmpty())
+            emit readyRead();
+    }
+    setFinished(true);
+    emit finished();
+}
+
+void UQQReplayReply::abort() {
+    if (m_done) return;
+    m_error = OperationCanceledError;
+    m_errorString = "aborted";
+    deliver();
+}
+
+bool UQQReplayReply::isSequential() const {
+    return true;
+}
+
+qint64 UQQReplayReply::bytesAvailable() const {
+    return m_data.size() - m_offset + QNetworkReply::bytesAvailable();
+}
+
+qint64 UQQReplayReply::readData(char *data, qint64 maxSize) {
+    if (m_offset >= m_data.size())
+        return m_done ? -1 : 0;
+
+    qint64 n = qMin(maxSize, qint64(m_data.size() - m_offset));
+    memcpy(data, m_data.constData() + m_offset, n);
+    m_offset += n;
+    return n;
+}
@@ -0,0 +1,101 @@
+#ifndef UQQNETWORKMANAGER_H
+#define UQQNETWORKMANAGER_H
+
+#include <QtNetwork>
+
+/*
+ * The transport under UQQClient::get()/post().
+ *
+ * Live passes requests through. Record passes them through as well and
+ * writes every reply body to the transport directory, one file per reply,
+ * with a line in manifest.json giving its path, file, status, latency and
+ * cookies. Replay never touches the network: replies are served from the
+ * manifest of the directory, per url path in recorded order, after the
+ * recorded latency divided by the speed (0 = at once). Lookups of one
+ * path run side by side and finish in any order, so the items naming
+ * their target (gcode, tuin, uin) are recorded as the entry's "query",
+ * e.g. "gcode=42" for the info of one group, and such an entry only
+ * answers a request with the same items. A path with no recording left
+ * fails with ContentNotFoundError.
+ *
+ * Chosen from the environment:
+ *   UQQ_TRANSPORT      live (default), record or replay
+ *   UQQ_TRANSPORT_DIR  directory of the recording (default "recording")
+ *   UQQ_REPLAY_SPEED   latency divisor for replay (default 1)
+ */
+class UQQNetworkManager : public QNetworkAccessManager
+{
+    Q_OBJECT
+public:
+    enum Mode {
+        LiveMode,
+        RecordMode,
+        ReplayMode
+    };
+
+    explicit UQQNetworkManager(QObject *parent = 0);
+
+    Mode mode() const;
+    void setMode(Mode mode, const QString &dir, double speed = 1.0);
+
+protected:
+    QNetworkReply *createRequest(Operation op, const QNetworkRequest &request,
+                                 QIODevice *outgoingData);
+
+private slots:
+    void onRecordFinished();
+
+private:
+    struct Entry {
+        QString file;
+        QString query;
+        int status;
+        int latency;    // ms
+        QList<QByteArray> cookies;
+    };
+
+    static QString targetKey(const QUrl &url);
+    bool loadManifest();
+    QNetworkReply *replay(Operation op, const QNetworkRequest &request);
+
+    Mode m_mode;
+    QDir m_dir;
+    double m_speed;
+    QHash<QString, QList<Entry> > m_entries;    // url path -> recorded replies
+    QHash<QNetworkReply *, qint64> m_startTimes;
+    QElapsedTimer m_clock;
+    int m_recorded;
+};
+
+/*
+ * A reply served from memory after a delay.
+ */
+class UQQReplayReply : public QNetworkReply
+{
+    Q_OBJECT
+public:
+    UQQReplayReply(QNetworkAccessManager::Operation op, const QNetworkRequest &request,
+                   QObject *parent = 0);
+
+    void serve(int status, const QByteArray &data, int delay);
+    void fail(NetworkError error, const QString &message, int delay);
+
+    void abort();
+    bool isSequential() const;
+    qint64 bytesAvailable() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+
+private slots:
+    void deliver();
+
+private:
+    QByteArray m_data;
+    qint64 m_offset;
+    NetworkError m_error;
+    QString m_errorString;
+    bool m_done;
+};
+
+#endif // UQQNETWORKMANAGER_H
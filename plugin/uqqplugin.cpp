@@ -3,6 +3,7 @@
 #include "uqqcontact.h"
 #include "uqqmemberdetail.h"
 #include "uqqgroupinfo.h"
+#include "uqqmessagehistory.h"
 
 #include <QtQml>
 
@@ -24,4 +25,6 @@ void UQQPlugin::registerTypes(const char *uri)
     qmlRegisterType<UQQMember>(uri, 1, 0, "Member");
     qmlRegisterType<UQQMemberDetail>(uri, 1, 0, "MemberDetail");
     qmlRegisterType<UQQGroupInfo>(uri, 1, 0, "GroupInfo");
+    qmlRegisterUncreatableType<UQQMessageHistory>(uri, 1, 0, "MessageHistory",
+                                                  "MessageHistory is provided by the client");
 }
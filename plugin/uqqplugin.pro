@@ -3,7 +3,7 @@ CONFIG += qt plugin
 QT += qml
 
 #DEFINES += QT_NO_DEBUG_OUTPUT QT_NO_WARNING_OUTPUT # no debug and warning output
-DEFINES += QT_NO_EXCEPTIONS="1" #UQQ_TEST
+# the plugin logs through uqqlog.h, levels are set at runtime with UQQ_LOG
 
 DESTDIR = UQQ
 TARGET = uqq
@@ -11,26 +11,11 @@ TARGET = uqq
 OBJECTS_DIR = tmp
 MOC_DIR = tmp
 
-SOURCES += uqqclient.cpp \
-           uqqplugin.cpp \
-    uqqcontact.cpp \
-    uqqmember.cpp \
-    uqqcategory.cpp \
-    uqqmessage.cpp \
-    uqqmemberdetail.cpp \
-    uqqgroup.cpp \
-    uqqgroupinfo.cpp
+include(uqqcore.pri)
 
-HEADERS += uqqclient.h \
-           uqqplugin.h \
-    uqqcontact.h \
-    uqqmember.h \
-    uqqcategory.h \
-    uqqmessage.h \
-    uqqmemberdetail.h \
-    uqqgroup.h \
-    uqqgroupinfo.h
+SOURCES += uqqplugin.cpp
+
+HEADERS += uqqplugin.h
 
 OTHER_FILES += \
     loginSuccess.txt
-
@@ -0,0 +1,126 @@
+#include "uqqpollengine.h"
+
+UQQPollEngine::UQQPollEngine(QObject *parent)
+    : QObject(parent) {
+    m_running = false;
+    m_overlap = false;
+    m_outstanding = 0;
+    m_failures = 0;
+    m_idleSince = -1;
+
+    m_polls = 0;
+    m_errors = 0;
+    m_lastLatency = 0;
+    m_averageLatency = 0;
+    m_lastGap = 0;
+    m_totalGap = 0;
+
+    m_clock.start();
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(send()));
+}
+
+bool UQQPollEngine::isRunning() const {
+    return m_running;
+}
+
+bool UQQPollEngine::overlap() const {
+    return m_overlap;
+}
+
+void UQQPollEngine::start(bool overlap) {
+    m_running = true;
+    m_overlap = overlap;
+    m_failures = 0;
+    m_idleSince = -1;   // the time before the first poll is no gap
+    arm(0);
+}
+
+// polls still outstanding are answered but not followed up
+void UQQPollEngine::stop() {
+    m_running = false;
+    m_timer->stop();
+}
+
+// polls again after a back off, e.g. when renewing the session failed
+void UQQPollEngine::retry() {
+    m_running = true;
+    m_failures++;
+    arm(backoff());
+}
+
+void UQQPollEngine::finished(Result result) {
+    qint64 now = m_clock.elapsed();
+
+    if (m_outstanding > 0)
+        m_outstanding--;
+    if (!m_sentAt.isEmpty()) {  // replies come back in order more often than not
+        m_lastLatency = now - m_sentAt.takeFirst();
+        m_averageLatency = m_polls + m_errors == 0 ?
+                    m_lastLatency : 0.9 * m_averageLatency + 0.1 * m_lastLatency;
+    }
+    if (m_outstanding == 0)
+        m_idleSince = now;
+
+    switch (result) {
+    case Succeeded:
+        m_polls++;
+        m_failures = 0;
+        if (m_running) arm(0);
+        break;
+    case Failed:
+        m_errors++;
+        m_failures++;
+        if (m_running) arm(backoff());
+        break;
+    case Offline:
+        m_errors++;
+        if (!m_running) break;
+        stop();
+        emit offline();
+        break;
+    }
+}
+
+QVariantMap UQQPollEngine::metrics() const {
+    QVariantMap m;
+    m.insert("running", m_running);
+    m.insert("outstanding", m_outstanding);
+    m.insert("polls", m_polls);
+    m.insert("errors", m_errors);
+    m.insert("lastLatency", m_lastLatency);
+    m.insert("averageLatency", qint64(m_averageLatency));
+    m.insert("lastGap", m_lastGap);
+    m.insert("totalGap", m_totalGap);
+    return m;
+}
+
+void UQQPollEngine::send() {
+    int target = m_overlap ? 2 : 1;
+    if (!m_running || m_outstanding >= target) return;
+
+    qint64 now = m_clock.elapsed();
+    if (m_outstanding == 0 && m_idleSince >= 0) {
+        m_lastGap = now - m_idleSince;
+        m_totalGap += m_lastGap;
+    }
+    m_idleSince = -1;
+    m_sentAt.append(now);
+    m_outstanding++;
+    emit pollRequested();
+
+    if (m_outstanding < target)
+        m_timer->start(OverlapDelay);
+}
+
+// MinBackoff doubled per failure, half of it random
+int UQQPollEngine::backoff() const {
+    int delay = qMin(MinBackoff << qBound(0, m_failures - 1, 6), int(MaxBackoff));
+    return delay / 2 + m_random.bounded(delay / 2 + 1);
+}
+
+void UQQPollEngine::arm(int delay) {
+    if (!m_timer->isActive() || delay < m_timer->remainingTime())
+        m_timer->start(delay);
+}
@@ -0,0 +1,79 @@
+#ifndef UQQPOLLENGINE_H
+#define UQQPOLLENGINE_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVariantMap>
+#include "uqqrandom.h"
+
+/*
+ * Keeps a poll2 request outstanding for as long as it is running.
+ *
+ * The engine only decides when to poll: it emits pollRequested() and the
+ * client reports every reply back with finished(). A successful reply is
+ * followed by the next poll at once, errors back off exponentially (with
+ * jitter) up to MaxBackoff, and an offline reply stops the loop and emits
+ * offline() so the session can be renewed. With overlap a second poll is
+ * kept outstanding, started OverlapDelay after the first, so there is
+ * always one waiting on the server while the other is being answered.
+ */
+class UQQPollEngine : public QObject
+{
+    Q_OBJECT
+public:
+    enum Result {
+        Succeeded,
+        Failed,
+        Offline
+    };
+
+    enum {
+        OverlapDelay = 30000,   // ms, half of the server hold time
+        MinBackoff = 1000,
+        MaxBackoff = 60000
+    };
+
+    explicit UQQPollEngine(QObject *parent = 0);
+
+    bool isRunning() const;
+    bool overlap() const;
+
+    void start(bool overlap = false);
+    void stop();
+    void retry();
+    void finished(Result result);
+
+    QVariantMap metrics() const;
+
+signals:
+    void pollRequested();
+    void offline();
+
+private slots:
+    void send();
+
+private:
+    int backoff() const;
+    void arm(int delay);
+
+    bool m_running;
+    bool m_overlap;
+    int m_outstanding;
+    int m_failures;
+    QTimer *m_timer;
+    mutable UQQRandom m_random;
+
+    QElapsedTimer m_clock;
+    QList<qint64> m_sentAt;     // send times of the outstanding polls
+    qint64 m_idleSince;         // -1 while a poll is outstanding
+
+    int m_polls;
+    int m_errors;
+    qint64 m_lastLatency;
+    double m_averageLatency;
+    qint64 m_lastGap;
+    qint64 m_totalGap;
+};
+
+#endif // UQQPOLLENGINE_H
@@ -0,0 +1,52 @@
+#include "uqqrandom.h"
+#include <QDateTime>
+
+static inline quint64 rotl(quint64 x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static quint64 splitmix64(quint64 *x) {
+    quint64 z = (*x += Q_UINT64_C(0x9e3779b97f4a7c15));
+    z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+// the clock and the address of the instance, two clients started in the
+// same millisecond still differ
+UQQRandom::UQQRandom() {
+    seed(quint64(QDateTime::currentMSecsSinceEpoch()) ^ (quint64(quintptr(this)) << 16));
+}
+
+UQQRandom::UQQRandom(quint64 seed) {
+    this->seed(seed);
+}
+
+void UQQRandom::seed(quint64 seed) {
+    for (int i = 0; i < 4; i++)
+        m_state[i] = splitmix64(&seed);
+}
+
+quint64 UQQRandom::next() {
+    const quint64 result = rotl(m_state[1] * 5, 7) * 9;
+    const quint64 t = m_state[1] << 17;
+
+    m_state[2] ^= m_state[0];
+    m_state[3] ^= m_state[1];
+    m_state[1] ^= m_state[2];
+    m_state[0] ^= m_state[3];
+    m_state[2] ^= t;
+    m_state[3] = rotl(m_state[3], 45);
+
+    return result;
+}
+
+// the high 32 bits scaled to the range, the bias is below 2^-32 * max
+int UQQRandom::bounded(int max) {
+    if (max <= 0) return 0;
+    return int(((next() >> 32) * quint64(max)) >> 32);
+}
+
+double UQQRandom::real() {
+    return (next() >> 11) * (1.0 / (Q_UINT64_C(1) << 53));
+}
@@ -0,0 +1,29 @@
+#ifndef UQQRANDOM_H
+#define UQQRANDOM_H
+
+#include <QtGlobal>
+
+/*
+ * xoshiro256** seeded through splitmix64.
+ *
+ * One instance is seeded once and then drawn from, unlike qsrand()/qrand()
+ * which had to be reseeded from the clock on every call and gave the same
+ * value twice within a millisecond. Not for cryptographic use.
+ */
+class UQQRandom
+{
+public:
+    UQQRandom();
+    explicit UQQRandom(quint64 seed);
+
+    void seed(quint64 seed);
+
+    quint64 next();
+    int bounded(int max);   // [0, max)
+    double real();          // [0, 1)
+
+private:
+    quint64 m_state[4];
+};
+
+#endif // UQQRANDOM_H
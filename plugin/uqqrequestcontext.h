@@ -0,0 +1,32 @@
+#ifndef UQQREQUESTCONTEXT_H
+#define UQQREQUESTCONTEXT_H
+
+#include <QMetaType>
+#include <QString>
+
+/*
+ * What the reply handler of a request needs to know, carried in the
+ * QNetworkRequest::UserMax attribute. Each action uses the fields it
+ * needs: gid and uin for member lookups, the status of a status change,
+ * the mask of a group mask change.
+ */
+struct UQQRequestContext
+{
+    UQQRequestContext() : gid(0), value(0) {}
+    explicit UQQRequestContext(quint64 gid, const QString &uin = QString(), int value = 0)
+        : gid(gid), uin(uin), value(value) {}
+
+    bool operator==(const UQQRequestContext &other) const {
+        return gid == other.gid && value == other.value && uin == other.uin
+                && text == other.text;
+    }
+
+    quint64 gid;
+    QString uin;
+    int value;
+    QString text;
+};
+
+Q_DECLARE_METATYPE(UQQRequestContext)
+
+#endif // UQQREQUESTCONTEXT_H
@@ -0,0 +1,135 @@
+#include "uqqrequestscheduler.h"
+
+UQQRequestScheduler::UQQRequestScheduler(QNetworkAccessManager *manager, QObject *parent)
+    : QObject(parent), m_manager(manager) {
+    connect(m_manager, SIGNAL(finished(QNetworkReply*)), this, SLOT(onFinished(QNetworkReply*)));
+}
+
+void UQQRequestScheduler::get(const QNetworkRequest &request, Priority priority,
+                              const QByteArray &key) {
+    Request r;
+    r.request = request;
+    r.post = false;
+    r.key = key;
+    r.priority = priority;
+    r.retried = false;
+    enqueue(r);
+}
+
+void UQQRequestScheduler::post(const QNetworkRequest &request, const QByteArray &data,
+                               Priority priority, const QByteArray &key) {
+    Request r;
+    r.request = request;
+    r.data = data;
+    r.post = true;
+    r.key = key;
+    r.priority = priority;
+    r.retried = false;
+    enqueue(r);
+}
+
+/*
+ * The coalesced requests that waited for this reply, the reply itself
+ * carries the attributes of the first one only.
+ */
+QList<QNetworkRequest> UQQRequestScheduler::takeWaiters(QNetworkReply *reply) {
+    QList<QNetworkRequest> requests;
+    QByteArray key = m_replyKeys.value(reply);
+    if (key.isEmpty()) return requests;
+
+    const QList<Request> &waiters = m_waiters.value(key);
+    for (int i = 1; i < waiters.size(); i++)  // the first one is the reply's own
+        requests.append(waiters.at(i).request);
+    return requests;
+}
+
+void UQQRequestScheduler::enqueue(const Request &request) {
+    if (!request.key.isEmpty()) {
+        QHash<QByteArray, QList<Request> >::Iterator iter = m_waiters.find(request.key);
+        if (iter != m_waiters.end()) {
+            UQQRequestContext context = qvariant_cast<UQQRequestContext>(
+                        request.request.attribute(QNetworkRequest::UserMax));
+            foreach (const Request &waiter, iter.value()) {
+                if (qvariant_cast<UQQRequestContext>(waiter.request.attribute(QNetworkRequest::UserMax)) == context) {
+                    emit dropped(request.request);  // the very same request, nothing to add
+                    return;
+                }
+            }
+            iter.value().append(request);
+            emit coalesced(request.request);
+            return;
+        }
+        m_waiters.insert(request.key, QList<Request>() << request);
+    }
+
+    if (request.priority == HighPriority) {
+        send(request);
+        return;
+    }
+    m_queues[request.priority].append(request);
+    dispatch();
+}
+
+void UQQRequestScheduler::dispatch() {
+    for (int priority = NormalPriority; priority < PriorityCount; priority++) {
+        QList<Request> &queue = m_queues[priority];
+        for (int i = 0; i < queue.size(); ) {
+            if (m_inFlight.value(queue.at(i).request.url().host()) >= MaxPerHost) {
+                i++;
+                continue;
+            }
+            Request request = queue.takeAt(i);
+            send(request);
+        }
+    }
+}
+
+void UQQRequestScheduler::send(const Request &request) {
+    QNetworkReply *reply;
+    QNetworkRequest r(request.request);
+
+    if (request.priority == HighPriority)
+        r.setPriority(QNetworkRequest::HighPriority);
+    else if (request.priority == LowPriority)
+        r.setPriority(QNetworkRequest::LowPriority);
+    if (request.post)
+        reply = m_manager->post(r, request.data);
+    else
+        reply = m_manager->get(r);
+
+    QString host = r.url().host();
+    m_inFlight[host]++;
+    m_replyHosts.insert(reply, host);
+    if (!request.key.isEmpty())
+        m_replyKeys.insert(reply, request.key);
+    emit sent(r);
+}
+
+void UQQRequestScheduler::onFinished(QNetworkReply *reply) {
+    QString host = m_replyHosts.take(reply);
+    if (m_inFlight.value(host) > 1)
+        m_inFlight[host]--;
+    else
+        m_inFlight.remove(host);
+
+    // waiters that get a retry are not handed to takeWaiters()
+    QList<Request> retries;
+    QByteArray key = m_replyKeys.value(reply);
+    QHash<QByteArray, QList<Request> >::Iterator iter = m_waiters.find(key);
+    if (reply->error() != QNetworkReply::NoError && iter != m_waiters.end() &&
+            iter.value().size() > 1 && !iter.value().first().retried) {
+        retries = iter.value().mid(1);
+        iter.value().erase(iter.value().begin() + 1, iter.value().end());
+    }
+
+    emit finished(reply);
+
+    m_replyKeys.remove(reply);
+    if (!key.isEmpty())
+        m_waiters.remove(key);
+    for (int i = 0; i < retries.size(); i++) {
+        retries[i].retried = true;
+        enqueue(retries.at(i));     // the first goes out, the others wait for it
+    }
+    dispatch();
+}
@@ -0,0 +1,80 @@
+#ifndef UQQREQUESTSCHEDULER_H
+#define UQQREQUESTSCHEDULER_H
+
+#include <QtNetwork>
+#include "uqqrequestcontext.h"
+
+/*
+ * Queues the client requests in front of the QNetworkAccessManager.
+ *
+ * High priority requests (poll, sends, login) go out at once. Normal and low
+ * priority ones are sent in priority order while their host has fewer than
+ * MaxPerHost requests in flight. A request with the key of one that is still
+ * queued or in flight is not sent again; it waits for that reply and can be
+ * picked up with takeWaiters() when it finishes. Requests are told apart by
+ * the UQQRequestContext in their UserMax attribute.
+ *
+ * When that reply fails the waiters are sent again once, coalesced among
+ * themselves, instead of sharing an error they had no try of their own
+ * for. If the retry fails too, takeWaiters() hands them to the receiver
+ * of finished() to be failed along with the reply.
+ *
+ * sent() is emitted for each request that goes to the manager, retries
+ * included, coalesced() for one that waits for another's reply and
+ * dropped() for one already queued or in flight with the same context.
+ */
+class UQQRequestScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    enum Priority {
+        HighPriority,
+        NormalPriority,
+        LowPriority,
+        PriorityCount
+    };
+
+    enum {
+        MaxPerHost = 4
+    };
+
+    explicit UQQRequestScheduler(QNetworkAccessManager *manager, QObject *parent = 0);
+
+    void get(const QNetworkRequest &request, Priority priority,
+             const QByteArray &key = QByteArray());
+    void post(const QNetworkRequest &request, const QByteArray &data, Priority priority,
+              const QByteArray &key = QByteArray());
+    QList<QNetworkRequest> takeWaiters(QNetworkReply *reply);
+
+signals:
+    void finished(QNetworkReply *reply);
+    void sent(const QNetworkRequest &request);
+    void coalesced(const QNetworkRequest &request);
+    void dropped(const QNetworkRequest &request);
+
+private slots:
+    void onFinished(QNetworkReply *reply);
+
+private:
+    struct Request {
+        QNetworkRequest request;
+        QByteArray data;
+        bool post;
+        QByteArray key;
+        Priority priority;
+        bool retried;
+    };
+
+    void enqueue(const Request &request);
+    void dispatch();
+    void send(const Request &request);
+
+    QNetworkAccessManager *m_manager;
+    QList<Request> m_queues[PriorityCount];
+    QHash<QString, int> m_inFlight;             // host -> requests in flight
+    QHash<QNetworkReply *, QString> m_replyHosts;
+    QHash<QNetworkReply *, QByteArray> m_replyKeys;
+    QHash<QByteArray, QList<Request> > m_waiters;   // queued or in flight keys
+};
+
+#endif // UQQREQUESTSCHEDULER_H
@@ -0,0 +1,132 @@
+#include "uqqsendqueue.h"
+#include "uqqmessage.h"
+
+UQQSendQueue::UQQSendQueue(QObject *parent)
+    : QObject(parent) {
+    m_clock.start();
+
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(pump()));
+}
+
+QString UQQSendQueue::conversation(const Outgoing &message) {
+    return QString("%1:%2:%3").arg(message.kind).arg(message.gid).arg(message.uin);
+}
+
+void UQQSendQueue::enqueue(int kind, quint64 gid, const QString &uin, const QString &content, int msgId) {
+    Outgoing message;
+    message.kind = kind;
+    message.gid = gid;
+    message.uin = uin;
+    message.content = content;
+    message.msgId = msgId;
+    message.attempts = 0;
+    message.notBefore = 0;
+
+    QString key = conversation(message);
+    QHash<QString, QList<Outgoing> >::Iterator iter = m_queues.find(key);
+    if (iter == m_queues.end()) {
+        iter = m_queues.insert(key, QList<Outgoing>());
+        m_turns.append(key);
+    }
+    iter.value().append(message);
+    m_timer->start(0);  // messages written in one go are handed out together
+}
+
+/*
+ * The reply to a send, ok when the server took the message. Replies to
+ * messages dropped by clear() are ignored.
+ */
+void UQQSendQueue::finished(int msgId, bool ok) {
+    QString key = m_inFlight.take(msgId);
+    if (key.isEmpty()) return;
+
+    QHash<QString, QList<Outgoing> >::Iterator iter = m_queues.find(key);
+    if (iter == m_queues.end()) return;
+    QList<Outgoing> &queue = iter.value();
+
+    int i = 0;
+    while (i < queue.size() && queue.at(i).msgId != msgId)
+        i++;
+    if (i == queue.size()) return;
+
+    Outgoing done = queue.at(i);
+    int state;
+    if (ok) {
+        state = UQQMessage::SentState;
+        queue.removeAt(i);
+    } else if (done.attempts < MaxAttempts) {
+        state = UQQMessage::QueuedState;
+        queue[i].notBefore = m_clock.elapsed() + RetryDelay * done.attempts;
+    } else {
+        state = UQQMessage::FailedState;
+        queue.removeAt(i);
+    }
+    if (queue.isEmpty()) {
+        m_queues.erase(iter);
+        m_turns.removeOne(key);
+    }
+
+    emit stateChanged(done.kind, done.gid, done.uin, done.msgId, state);
+    m_timer->start(0);
+}
+
+void UQQSendQueue::clear() {
+    m_queues.clear();
+    m_turns.clear();
+    m_inFlight.clear();
+    m_timer->stop();
+}
+
+/*
+ * The index of the next message of a conversation to send, -1 if its
+ * window is full or the next one waits for a retry.
+ */
+int UQQSendQueue::nextToSend(const QList<Outgoing> &queue, qint64 now, qint64 *wait) const {
+    for (int i = 0; i < queue.size() && i < Window; i++) {
+        const Outgoing &message = queue.at(i);
+        if (m_inFlight.contains(message.msgId)) continue;
+        if (message.notBefore > now) {  // a retry keeps its place
+            qint64 left = message.notBefore - now;
+            *wait = *wait < 0 ? left : qMin(*wait, left);
+            return -1;
+        }
+        return i;
+    }
+    return -1;
+}
+
+void UQQSendQueue::pump() {
+    qint64 now = m_clock.elapsed();
+    qint64 wait = -1;
+    QList<Outgoing> ready;
+
+    // rounds of one message per conversation, each turn moves it to the back
+    bool progress = true;
+    while (progress && m_inFlight.size() < MaxInFlight) {
+        progress = false;
+        for (int n = m_turns.size(); n > 0 && m_inFlight.size() < MaxInFlight; n--) {
+            QString key = m_turns.takeFirst();
+            m_turns.append(key);
+
+            QList<Outgoing> &queue = m_queues[key];
+            int i = nextToSend(queue, now, &wait);
+            if (i < 0) continue;
+
+            Outgoing &message = queue[i];
+            message.attempts++;
+            m_inFlight.insert(message.msgId, key);
+            ready.append(message);
+            progress = true;
+        }
+    }
+    if (wait >= 0)
+        m_timer->start(int(wait));
+
+    // the handlers may report back at once, so nothing is iterated any more
+    foreach (const Outgoing &message, ready) {
+        emit stateChanged(message.kind, message.gid, message.uin, message.msgId, UQQMessage::SendingState);
+        emit sendRequested(message.kind, message.gid, message.uin, message.content, message.msgId);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef UQQSENDQUEUE_H
+#define UQQSENDQUEUE_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QTimer>
+#include <QElapsedTimer>
+
+/*
+ * Queues the outgoing chat messages, one queue per conversation.
+ *
+ * Messages of a conversation go out in the order they were written, up to
+ * Window of them on their way at once, so a burst is not paced by the
+ * round trip of every message. Conversations take turns, one message per
+ * turn, up to MaxInFlight sends in total; the turn order carries over to
+ * the next pump, so a busy conversation can not keep the others waiting.
+ *
+ * A failed send is retried with the same msg_id, so the server can tell a
+ * retry from a new message, after RetryDelay ms times the attempts so far.
+ * Messages behind it that are not sent yet wait for the retry, the ones
+ * already on their way may arrive before it. After MaxAttempts the message
+ * is given up.
+ *
+ * Every change of a message's delivery state is reported by stateChanged()
+ * with the states of UQQMessage::DeliveryState.
+ */
+class UQQSendQueue : public QObject
+{
+    Q_OBJECT
+public:
+    enum {
+        Window = 4,         // per conversation
+        MaxInFlight = 8,
+        MaxAttempts = 3,
+        RetryDelay = 2000   // ms
+    };
+
+    explicit UQQSendQueue(QObject *parent = 0);
+
+    void enqueue(int kind, quint64 gid, const QString &uin, const QString &content, int msgId);
+    void finished(int msgId, bool ok);
+    void clear();
+
+signals:
+    void sendRequested(int kind, quint64 gid, const QString &uin, const QString &content, int msgId);
+    void stateChanged(int kind, quint64 gid, const QString &uin, int msgId, int state);
+
+private slots:
+    void pump();
+
+private:
+    struct Outgoing {
+        int kind;
+        quint64 gid;
+        QString uin;
+        QString content;
+        int msgId;
+        int attempts;
+        qint64 notBefore;   // ms on m_clock, for retries
+    };
+
+    static QString conversation(const Outgoing &message);
+    int nextToSend(const QList<Outgoing> &queue, qint64 now, qint64 *wait) const;
+
+    QHash<QString, QList<Outgoing> > m_queues;  // conversation -> unacknowledged messages, oldest first
+    QList<QString> m_turns;                     // conversations, the next to be served first
+    QHash<int, QString> m_inFlight;             // msg_id -> conversation
+    QTimer *m_timer;
+    QElapsedTimer m_clock;
+};
+
+#endif // UQQSENDQUEUE_H
@@ -0,0 +1,6 @@
+# Unit tests of the client code, run them with make check.
+
+TEMPLATE = subdirs
+
+SUBDIRS += uqqjsonreader \
+    uqqcontentcodec
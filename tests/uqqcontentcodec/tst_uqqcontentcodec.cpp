@@ -0,0 +1,191 @@
+#include <QtTest>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include "uqqcontentcodec.h"
+#include "uqqrandom.h"
+
+class tst_UQQContentCodec : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void encode_data();
+    void encode();
+    void reuseBuffer();
+    void fuzz();
+    void decode();
+};
+
+/*
+ * Parses an encoded content array back into its text form, faces as
+ * "[faceN]". Fails the test if it is not valid JSON or the font entry is
+ * not last.
+ */
+static bool parseContent(const QString &content, QString *text) {
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(content.toUtf8(), &error);
+    if (error.error != QJsonParseError::NoError || !doc.isArray()) {
+        qWarning("invalid content: %s at %d", qPrintable(error.errorString()), error.offset);
+        return false;
+    }
+
+    QJsonArray array = doc.array();
+    if (array.isEmpty() || array.last().toArray().at(0).toString() != "font")
+        return false;
+    array.removeLast();
+
+    text->clear();
+    foreach (const QJsonValue &value, array) {
+        if (value.isString()) {
+            text->append(value.toString());
+        } else if (value.isArray() && value.toArray().at(0).toString() == "face") {
+            text->append(QString("[face%1]").arg(int(value.toArray().at(1).toDouble())));
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the text form split() gives, what parseContent() has to get back
+static QString expected(const QString &text) {
+    QString result;
+    foreach (const UQQMessageSegment &segment, UQQContentCodec::split(text)) {
+        if (segment.type == UQQMessageSegment::FaceSegment)
+            result.append(QString("[face%1]").arg(segment.face));
+        else
+            result.append(segment.text);
+    }
+    return result;
+}
+
+void tst_UQQContentCodec::encode_data() {
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QString>("parsed");
+
+    const QChar pair[] = { QChar(0xd83d), QChar(0xde00) };
+    const QChar high[] = { QChar('a'), QChar(0xd83d), QChar('b') };
+    const QChar low[] = { QChar(0xde00), QChar('c') };
+    QString controls;
+    for (int c = 0; c < 0x20; c++)
+        controls.append(QChar(c));
+
+    QTest::newRow("empty") << QString() << QString();
+    QTest::newRow("plain") << QString("hello") << QString("hello");
+    QTest::newRow("quotes") << QString("say \"hi\"") << QString("say \"hi\"");
+    QTest::newRow("backslashes") << QString("C:\\path\\\\ \\u0041 \\") << QString("C:\\path\\\\ \\u0041 \\");
+    QTest::newRow("controls") << controls << controls;
+    QTest::newRow("chinese") << QString::fromUtf8("\xE4\xBD\xA0\xE5\xA5\xBD") << QString::fromUtf8("\xE4\xBD\xA0\xE5\xA5\xBD");
+    QTest::newRow("surrogate pair") << QString(pair, 2) << QString(pair, 2);
+    QTest::newRow("lone high surrogate") << QString(high, 3) << QString("a") + QChar(0xfffd) + "b";
+    QTest::newRow("lone low surrogate") << QString(low, 2) << QChar(0xfffd) + QString("c");
+    QTest::newRow("faces") << QString("[face1]hi[face14][face134]") << QString("[face1]hi[face14][face134]");
+    QTest::newRow("leading zeros") << QString("[face007][face0]") << QString("[face7][face0]");
+    QTest::newRow("no digits") << QString("[face]") << QString("[face]");
+    QTest::newRow("too many digits") << QString("[face1234]") << QString("[face1234]");
+    QTest::newRow("unterminated") << QString("[face12") << QString("[face12");
+    QTest::newRow("prefix only") << QString("[fac") << QString("[fac");
+    QTest::newRow("space") << QString("[face 1]") << QString("[face 1]");
+    QTest::newRow("nested") << QString("[[face1]]") << QString("[[face1]]");
+    QTest::newRow("quoted face") << QString("\"[face2]\"") << QString("\"[face2]\"");
+}
+
+void tst_UQQContentCodec::encode() {
+    QFETCH(QString, text);
+    QFETCH(QString, parsed);
+    UQQContentCodec codec;
+    QString result;
+
+    QVERIFY(parseContent(codec.encode(text), &result));
+    QCOMPARE(result, parsed);
+}
+
+void tst_UQQContentCodec::reuseBuffer() {
+    UQQContentCodec codec;
+    QString longText(10000, QChar('x'));
+
+    QString first = codec.encode(longText);
+    QString second = codec.encode("short");
+    QString result;
+    QVERIFY(parseContent(first, &result));
+    QCOMPARE(result, longText);
+    QVERIFY(parseContent(second, &result));
+    QCOMPARE(result, QString("short"));
+}
+
+// a piece of pasted text, faces and their broken forms included
+static void appendPiece(QString &text, UQQRandom &random) {
+    static const char *const Pieces[] = {
+        "hello ", "\"", "\\", "\\n", "/", "[", "]", "[face", "face]", "[face]",
+        "http://web.qq.com/?a=1&b=\"2\"", "\xE4\xBD\xA0\xE5\xA5\xBD", "\xE3\x80\x90\xE6\x8F\x90\xE7\xA4\xBA\xE3\x80\x91"
+    };
+    static const int PieceCount = sizeof(Pieces) / sizeof(Pieces[0]);
+
+    switch (random.bounded(6)) {
+    case 0:
+        text.append(QString::fromUtf8(Pieces[random.bounded(PieceCount)]));
+        break;
+    case 1:     // well formed or not
+        text.append(QString("[face%1").arg(random.bounded(2000)));
+        if (random.bounded(4))
+            text.append(QLatin1Char(']'));
+        break;
+    case 2:
+        text.append(QChar(random.bounded(0x20)));
+        break;
+    case 3: {   // outside the BMP
+        uint ucs4 = 0x10000 + random.bounded(0x100000);
+        text.append(QChar(QChar::highSurrogate(ucs4))).append(QChar(QChar::lowSurrogate(ucs4)));
+        break;
+    }
+    case 4:     // CJK and other BMP characters
+        text.append(QChar(0x4e00 + random.bounded(0x5000)));
+        break;
+    default:
+        text.append(QChar(0x20 + random.bounded(0x5f)));
+    }
+}
+
+void tst_UQQContentCodec::fuzz() {
+    UQQRandom random(20131017);
+    UQQContentCodec codec;
+
+    for (int i = 0; i < 300; i++) {
+        QString text;
+        int pieces = random.bounded(i % 10 == 0 ? 20000 : 200);
+        for (int j = 0; j < pieces; j++)
+            appendPiece(text, random);
+
+        QString result;
+        if (!parseContent(codec.encode(text), &result))
+            QFAIL(qPrintable(QString("round %1 does not parse").arg(i)));
+        if (result != expected(text))
+            QFAIL(qPrintable(QString("round %1 differs").arg(i)));
+    }
+}
+
+void tst_UQQContentCodec::decode() {
+    UQQMessage message;
+    UQQContentCodec::decode("[[\"font\",{\"size\":10,\"color\":\"000000\",\"style\":[1,0,1],\"name\":\"Arial\"}],"
+                            "\"hello \",[\"face\",14],[\"face\",2],\"world\",[\"cface\",\"x.jpg\"],\" \"]", &message);
+
+    const QVector<UQQMessageSegment> &segments = message.segments();
+    QCOMPARE(segments.size(), 4);
+    QCOMPARE(segments.at(0).text, QString("hello "));
+    QCOMPARE(segments.at(1).type, int(UQQMessageSegment::FaceSegment));
+    QCOMPARE(segments.at(1).face, 14);
+    QCOMPARE(segments.at(2).face, 2);
+    QCOMPARE(segments.at(3).text, QString("world[cface] "));
+    QCOMPARE(message.fontStyle(), int(UQQMessage::Bold | UQQMessage::Underline));
+    QCOMPARE(message.content(), QString("hello [face14][face2]world[cface] "));
+
+    // the text form read back from the log gives the same segments
+    UQQMessage logged;
+    logged.setContent(message.content());
+    QCOMPARE(logged.segments().size(), 4);
+    QCOMPARE(logged.content(), message.content());
+}
+
+QTEST_APPLESS_MAIN(tst_UQQContentCodec)
+
+#include "tst_uqqcontentcodec.moc"
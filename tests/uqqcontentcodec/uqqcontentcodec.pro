@@ -0,0 +1,13 @@
+TEMPLATE = app
+TARGET = tst_uqqcontentcodec
+CONFIG += testcase console
+CONFIG -= app_bundle
+QT += testlib
+QT -= gui
+
+OBJECTS_DIR = tmp
+MOC_DIR = tmp
+
+include(../../plugin/uqqcore.pri)
+
+SOURCES += tst_uqqcontentcodec.cpp
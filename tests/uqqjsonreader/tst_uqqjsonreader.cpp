@@ -0,0 +1,191 @@
+#include <QtTest>
+#include "uqqjsonreader.h"
+
+class tst_UQQJsonReader : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void readObject();
+    void readStrings();
+    void readNumbers();
+    void readRaw();
+    void skipNested();
+    void malformed_data();
+    void malformed();
+    void malformedPoll();
+};
+
+// walks every value like the parsers do, returns the number of steps
+static int walk(UQQJsonReader &reader, int depth = 0) {
+    int steps = 1;
+    if (depth > 64) return steps;
+
+    if (reader.enterObject()) {
+        while (reader.nextName() && steps < 10000)
+            steps += walk(reader, depth + 1);
+    } else if (reader.enterArray()) {
+        while (reader.nextElement() && steps < 10000)
+            steps += walk(reader, depth + 1);
+    } else {
+        reader.skip();
+    }
+    return steps;
+}
+
+void tst_UQQJsonReader::readObject() {
+    UQQJsonReader reader("{\"retcode\":0, \"result\" : {\"uin\":121830387,\"status\":\"online\"}}");
+    qint64 retCode = -1;
+    quint64 uin = 0;
+    QString status;
+
+    QVERIFY(reader.enterObject());
+    while (reader.nextName()) {
+        if (reader.nameIs("retcode")) {
+            retCode = reader.readInt();
+        } else if (reader.nameIs("result")) {
+            QVERIFY(reader.enterObject());
+            while (reader.nextName()) {
+                if (reader.nameIs("uin"))
+                    uin = reader.readUInt();
+                else if (reader.nameIs("status"))
+                    status = reader.readString();
+                else
+                    reader.skip();
+            }
+        } else {
+            reader.skip();
+        }
+    }
+    QVERIFY(!reader.hasError());
+    QCOMPARE(retCode, qint64(0));
+    QCOMPARE(uin, quint64(121830387));
+    QCOMPARE(status, QString("online"));
+}
+
+void tst_UQQJsonReader::readStrings() {
+    UQQJsonReader reader("[\"plain\",\"a\\\"b\\\\c\\/d\\n\",\"\\u4F60\\u597D\",\"\\uD83D\\uDE00\",\"\xE4\xBD\xA0\"]");
+
+    QVERIFY(reader.enterArray());
+    QVERIFY(reader.nextElement());
+    QCOMPARE(reader.readRawString(), QByteArray("plain"));
+    QVERIFY(reader.nextElement());
+    QCOMPARE(reader.readString(), QString("a\"b\\c/d\n"));
+    QVERIFY(reader.nextElement());
+    QCOMPARE(reader.readString(), QString::fromUtf8("\xE4\xBD\xA0\xE5\xA5\xBD"));
+    QVERIFY(reader.nextElement());
+    QCOMPARE(reader.readString(), QString::fromUtf8("\xF0\x9F\x98\x80"));
+    QVERIFY(reader.nextElement());
+    QCOMPARE(reader.readString(), QString::fromUtf8("\xE4\xBD\xA0"));
+    QVERIFY(!reader.nextElement());
+    QVERIFY(!reader.hasError());
+}
+
+void tst_UQQJsonReader::readNumbers() {
+    UQQJsonReader reader("[-12, \"3456\", 1.5e2, true, 18446744073709551615]");
+
+    QVERIFY(reader.enterArray());
+    QVERIFY(reader.nextElement());
+    QCOMPARE(reader.readInt(), qint64(-12));
+    QVERIFY(reader.nextElement());
+    QCOMPARE(reader.readInt(), qint64(3456));     // numbers sent as strings
+    QVERIFY(reader.nextElement());
+    QCOMPARE(reader.readDouble(), 150.0);
+    QVERIFY(reader.nextElement());
+    QCOMPARE(reader.readInt(), qint64(1));
+    QVERIFY(reader.nextElement());
+    QCOMPARE(reader.readUInt(), Q_UINT64_C(18446744073709551615));
+    QVERIFY(!reader.nextElement());
+    QVERIFY(!reader.hasError());
+}
+
+void tst_UQQJsonReader::readRaw() {
+    QByteArray data("{\"value\":{\"a\":[1,\"]\"]},\"poll_type\":\"message\"}");
+    UQQJsonReader reader(data);
+    QByteArray value;
+
+    QVERIFY(reader.enterObject());
+    while (reader.nextName()) {
+        if (reader.nameIs("value"))
+            value = reader.readRaw();
+        else
+            reader.skip();
+    }
+    QCOMPARE(value, QByteArray("{\"a\":[1,\"]\"]}"));
+
+    UQQJsonReader inner(value);
+    QVERIFY(inner.enterObject());
+    QVERIFY(inner.nextName());
+    QVERIFY(inner.nameIs("a"));
+}
+
+void tst_UQQJsonReader::skipNested() {
+    UQQJsonReader reader("{\"a\":{\"b\":[{\"c\":\"}\"},[]]},\"d\":null,\"e\":false,\"f\":7}");
+    qint64 f = 0;
+
+    QVERIFY(reader.enterObject());
+    while (reader.nextName()) {
+        if (reader.nameIs("f"))
+            f = reader.readInt();
+        else
+            reader.skip();
+    }
+    QVERIFY(!reader.hasError());
+    QCOMPARE(f, qint64(7));
+}
+
+void tst_UQQJsonReader::malformed_data() {
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("bare word in array") << QByteArray("{\"retcode\":0,\"result\":[x]}");
+    QTest::newRow("empty element") << QByteArray("{\"retcode\":0,\"result\":[1,,2]}");
+    QTest::newRow("missing value") << QByteArray("{\"a\":}");
+    QTest::newRow("missing colon") << QByteArray("{\"a\" 1}");
+    QTest::newRow("unquoted name") << QByteArray("{a:1}");
+    QTest::newRow("unterminated string") << QByteArray("{\"a\":\"b");
+    QTest::newRow("unterminated object") << QByteArray("{\"a\":{\"b\":1");
+    QTest::newRow("unterminated array") << QByteArray("[1,2");
+    QTest::newRow("truncated") << QByteArray("{\"retcode\":0,\"result\":[{\"poll_type\":\"mess");
+    QTest::newRow("garbage") << QByteArray("{\"a\":@#$%}");
+}
+
+void tst_UQQJsonReader::malformed() {
+    QFETCH(QByteArray, data);
+    UQQJsonReader reader(data);
+
+    QVERIFY(walk(reader) < 10000);
+    QVERIFY(reader.hasError());
+    // an error state ends every loop right away
+    QVERIFY(!reader.nextName());
+    QVERIFY(!reader.nextElement());
+}
+
+// the loop of UQQClient::parsePoll, it used to spin on such a reply
+void tst_UQQJsonReader::malformedPoll() {
+    UQQJsonReader reader("{\"retcode\":0,\"result\":[x]}");
+    int events = 0;
+    int steps = 0;
+
+    QVERIFY(reader.enterObject());
+    while (reader.nextName() && ++steps < 100) {
+        if (reader.nameIs("result") && reader.enterArray()) {
+            while (reader.nextElement() && ++steps < 100) {
+                if (!reader.enterObject()) {
+                    reader.skip();
+                    continue;
+                }
+                events++;
+                reader.skip();
+            }
+        } else {
+            reader.skip();
+        }
+    }
+    QVERIFY(steps < 100);
+    QVERIFY(reader.hasError());
+    QCOMPARE(events, 0);
+}
+
+QTEST_APPLESS_MAIN(tst_UQQJsonReader)
+
+#include "tst_uqqjsonreader.moc"
@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+"""
+A local stand-in for the WebQQ hosts, serving the fixtures in test/.
+
+    $ python3 tools/mockserver.py --port 8080 --latency 80 --jitter 40
+    $ UQQ_ENDPOINT=http://127.0.0.1:8080 sh uqq.sh
+
+Every reply is delayed by latency +- jitter ms. A share of the requests
+fails with HTTP 503 (--error-rate) and a share of the polls answers
+retcode 103 (--expire-rate), which makes the client renew its session.
+poll2 is held open up to --hold seconds and answered with the next poll
+fixture as soon as an event is due (one every --event-interval seconds),
+or with retcode 102 when nothing happened. --seed makes a run repeatable.
+"""
+
+import argparse
+import os
+import random
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import urlparse, parse_qs
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir)
+FIXTURES = os.path.join(ROOT, "test")
+
+JSON = "application/json; charset=utf-8"
+TEXT = "application/javascript; charset=utf-8"
+
+RETOK = "retok.txt"
+ROUTES = {
+    "/check": ("verifycode.txt", TEXT),
+    "/channel/login2": ("loginSuccess.txt", JSON),
+    "/channel/logout2": (RETOK, JSON),
+    "/channel/change_status2": (RETOK, JSON),
+    "/channel/get_online_buddies2": ("status.txt", JSON),
+    "/channel/get_c2cmsg_sig2": ("group_sig.txt", JSON),
+    "/channel/send_buddy_msg2": (RETOK, JSON),
+    "/channel/send_qun_msg2": (RETOK, JSON),
+    "/channel/send_sess_msg2": (RETOK, JSON),
+    "/api/get_friend_uin2": ("account.txt", JSON),
+    "/api/get_single_long_nick2": ("lnick.txt", JSON),
+    "/api/get_qq_level2": ("level.txt", JSON),
+    "/api/get_friend_info2": ("user.txt", JSON),
+    "/api/get_stranger_info2": ("user.txt", JSON),
+    "/api/get_user_friends2": ("friends.txt", JSON),
+    "/api/get_group_name_list_mask2": ("group.txt", JSON),
+    "/keycgi/qqweb/uac/messagefilter.do": (RETOK, JSON),
+}
+IMAGES = {
+    "/getimage": (os.path.join(ROOT, "logo.png"), "image/png"),
+    "/cgi/svr/face/getface": (os.path.join(ROOT, "face.gif"), "image/gif"),
+}
+GROUP_INFOS = ["groupinfo01.txt", "groupinfo02.txt", "groupinfo03.txt", "groupinfo04.txt"]
+POLL_EVENTS = ["hello_msg.txt", "groupmsg.txt", "sess_msg.txt", "helloworld_msg.txt",
+               "input_notify.txt"]
+
+POLL_EMPTY = b'{"retcode":102,"errmsg":""}'
+POLL_EXPIRED = b'{"retcode":103,"errmsg":""}'
+LOGIN_OK = ("ptuiCB('0','0','http://web.qq.com/loginproxy.html?login2qq=1&webqq_type=10',"
+            "'0','登录成功！', 'uqq');").encode("utf-8")
+
+
+def read(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+class Events:
+    """Poll events due at a fixed interval, handed to whichever poll waits."""
+
+    def __init__(self, interval):
+        self.interval = interval
+        self.cond = threading.Condition()
+        self.next_at = time.monotonic() + interval
+        self.index = 0
+
+    def wait(self, hold):
+        deadline = time.monotonic() + hold
+        with self.cond:
+            while True:
+                now = time.monotonic()
+                if self.interval > 0 and now >= self.next_at:
+                    self.next_at = now + self.interval
+                    name = POLL_EVENTS[self.index % len(POLL_EVENTS)]
+                    self.index += 1
+                    return read(os.path.join(FIXTURES, name))
+                wake = deadline if self.interval <= 0 else min(deadline, self.next_at)
+                if now >= deadline:
+                    return None
+                self.cond.wait(wake - now)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_GET(self):
+        self.handle_request()
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        self.rfile.read(length)
+        self.handle_request()
+
+    def handle_request(self):
+        opts = self.server.opts
+        started = time.monotonic()
+        url = urlparse(self.path)
+        path = url.path
+
+        rng = self.server.rng
+        with self.server.lock:
+            delay = max(0.0, opts.latency + rng.uniform(-opts.jitter, opts.jitter)) / 1000.0
+            failed = rng.random() < opts.error_rate
+            expired = rng.random() < opts.expire_rate
+        time.sleep(delay)
+
+        if failed:
+            self.reply(503, b"", "text/plain")
+        elif path == "/channel/poll2":
+            body = POLL_EXPIRED if expired else self.server.events.wait(opts.hold) or POLL_EMPTY
+            self.reply(200, body, JSON)
+        elif path == "/login":
+            self.reply(200, LOGIN_OK, TEXT, ["ptwebqq=%032x; Path=/" % rng.getrandbits(128)])
+        elif path == "/api/get_group_info_ext2":
+            gcode = parse_qs(url.query).get("gcode", ["0"])[0]
+            name = GROUP_INFOS[int(gcode) % len(GROUP_INFOS)] if gcode.isdigit() else GROUP_INFOS[0]
+            self.reply(200, read(os.path.join(FIXTURES, name)), JSON)
+        elif path in ROUTES:
+            name, ctype = ROUTES[path]
+            self.reply(200, read(os.path.join(FIXTURES, name)), ctype)
+        elif path in IMAGES:
+            name, ctype = IMAGES[path]
+            self.reply(200, read(name), ctype)
+        else:
+            self.reply(404, b"", "text/plain")
+
+        if not opts.quiet:
+            sys.stdout.write("%s %s %.0f ms\n" % (self.command, path,
+                                                 (time.monotonic() - started) * 1000))
+            sys.stdout.flush()
+
+    def reply(self, status, body, ctype, cookies=()):
+        self.send_response(status)
+        self.send_header("Content-Type", ctype)
+        self.send_header("Content-Length", str(len(body)))
+        for cookie in cookies:
+            self.send_header("Set-Cookie", cookie)
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, format, *args):
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Serve the test/ fixtures as the WebQQ hosts.")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--latency", type=float, default=0, help="reply delay, ms")
+    parser.add_argument("--jitter", type=float, default=0, help="+- random part of the delay, ms")
+    parser.add_argument("--error-rate", type=float, default=0, help="share of HTTP 503 replies")
+    parser.add_argument("--expire-rate", type=float, default=0, help="share of polls expiring the session")
+    parser.add_argument("--hold", type=float, default=30, help="longest poll hold, s")
+    parser.add_argument("--event-interval", type=float, default=5, help="s between poll events, 0: none")
+    parser.add_argument("--seed", type=int, default=None)
+    parser.add_argument("--quiet", action="store_true")
+    opts = parser.parse_args()
+
+    server = ThreadingHTTPServer((opts.host, opts.port), Handler)
+    server.daemon_threads = True
+    server.opts = opts
+    server.rng = random.Random(opts.seed)
+    server.lock = threading.Lock()
+    server.events = Events(opts.event_interval)
+
+    print("mock WebQQ on http://%s:%d" % (opts.host, opts.port))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,97 @@
+#include <QCoreApplication>
+#include <QStringList>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <stdio.h>
+#include "uqqreplaybench.h"
+#include "uqqloadgenerator.h"
+#include "uqqcodecbench.h"
+
+static void usage() {
+    fprintf(stderr,
+            "usage: uqqbench replay <dir> [--speed <n>] [--uin <uin>] [--timeout <s>]\n"
+            "       uqqbench generate <dir> [--buddies <n>] [--groups <n>] [--members <n>]\n"
+            "                [--messages <n>] [--churn <n>] [--eventsPerPoll <n>] [--seed <n>]\n"
+            "       uqqbench decode [--fixtures <dir>] [--messages <n>] [--perPoll <n>] [--rounds <n>]\n"
+            "       uqqbench encode [--length <n>] [--messages <n>] [--rounds <n>]\n"
+            "\n"
+            "  replay    drive the client through a recorded session\n"
+            "            (UQQ_TRANSPORT=record writes one), --speed divides\n"
+            "            the recorded latencies, 0 replays without delay\n"
+            "  generate  write a synthetic session of the given size to replay\n"
+            "  decode    decode poll replies made of the fixtures in test/\n"
+            "  encode    encode pasted texts of the given length for sending\n");
+}
+
+static QString option(const QStringList &args, const QString &name, const QString &value) {
+    int i = args.indexOf(name);
+    return i >= 0 && i + 1 < args.size() ? args.at(i + 1) : value;
+}
+
+static void print(const QVariantMap &result) {
+    QByteArray json = QJsonDocument(QJsonObject::fromVariantMap(result)).toJson();
+    fwrite(json.constData(), 1, json.size(), stdout);
+    fflush(stdout);
+}
+
+static int generate(const QStringList &args) {
+    static const char *const Names[] = {
+        "buddies", "groups", "members", "messages", "churn", "eventsPerPoll", "seed"
+    };
+
+    QVariantMap params;
+    for (unsigned i = 0; i < sizeof(Names) / sizeof(Names[0]); i++) {
+        QString value = option(args, QString("--") + Names[i], QString());
+        if (!value.isEmpty())
+            params.insert(Names[i], value);
+    }
+
+    UQQLoadGenerator generator((UQQLoadGenerator::Params(params)));
+    if (!generator.writeRecording(args.at(2))) {
+        fprintf(stderr, "uqqbench: can not write %s\n", qPrintable(args.at(2)));
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+
+    if (args.value(1) == "decode") {
+        print(UQQCodecBench::decode(option(args, "--fixtures", "test"),
+                                    option(args, "--messages", "20000").toInt(),
+                                    option(args, "--perPoll", "20").toInt(),
+                                    option(args, "--rounds", "5").toInt()));
+        return 0;
+    }
+    if (args.value(1) == "encode") {
+        print(UQQCodecBench::encode(option(args, "--length", "2000").toInt(),
+                                    option(args, "--messages", "1000").toInt(),
+                                    option(args, "--rounds", "5").toInt()));
+        return 0;
+    }
+    if (args.size() < 3) {
+        usage();
+        return 2;
+    }
+    if (args.at(1) == "generate")
+        return generate(args);
+    if (args.at(1) != "replay") {
+        usage();
+        return 2;
+    }
+
+    UQQReplayBench bench;
+    QObject::connect(&bench, SIGNAL(finished(bool)), &app, SLOT(quit()));
+    if (!bench.start(args.at(2),
+                     option(args, "--speed", "0").toDouble(),
+                     option(args, "--uin", "121830387"),
+                     option(args, "--timeout", "600").toInt()))
+        return 1;
+
+    app.exec();
+    print(bench.result());
+    return bench.result().value("ok").toBool() ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+# Headless benchmarks of the client, see main.cpp for the commands.
+
+TEMPLATE = app
+TARGET = uqqbench
+CONFIG += console
+CONFIG -= app_bundle
+QT -= gui
+
+OBJECTS_DIR = tmp
+MOC_DIR = tmp
+
+include(../../plugin/uqqcore.pri)
+
+SOURCES += main.cpp \
+    uqqreplaybench.cpp \
+    uqqloadgenerator.cpp \
+    uqqcodecbench.cpp
+
+HEADERS += uqqreplaybench.h \
+    uqqloadgenerator.h \
+    uqqcodecbench.h
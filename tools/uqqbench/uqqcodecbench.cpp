@@ -0,0 +1,287 @@
+#include "uqqcodecbench.h"
+#include "uqqjsonreader.h"
+#include "uqqcontentcodec.h"
+#include "uqqrandom.h"
+#include <QDir>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QRegExp>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+
+// the fixtures holding poll2 replies
+static const char *const PollFixtures[] = {
+    "groupmsg.txt",
+    "hello_msg.txt",
+    "helloworld_msg.txt",
+    "hello_cn.txt",
+    "helloworld_cn.txt",
+    "sess_msg.txt",
+    "input_notify.txt"
+};
+static const int PollFixtureCount = sizeof(PollFixtures) / sizeof(PollFixtures[0]);
+
+QList<QByteArray> UQQCodecBench::fixtureEvents(const QString &fixtures) {
+    QList<QByteArray> events;
+    QDir dir(fixtures);
+
+    for (int i = 0; i < PollFixtureCount; i++) {
+        QFile file(dir.filePath(PollFixtures[i]));
+        if (!file.open(QIODevice::ReadOnly)) continue;
+
+        QByteArray data = file.readAll();
+        UQQJsonReader reader(data);
+        if (!reader.enterObject()) continue;
+        while (reader.nextName()) {
+            if (reader.nameIs("result") && reader.enterArray()) {
+                while (reader.nextElement()) {
+                    // readRaw() only points into data, which goes away
+                    const QByteArray raw = reader.readRaw();
+                    events.append(QByteArray(raw.constData(), raw.size()));
+                }
+            } else {
+                reader.skip();
+            }
+        }
+    }
+    return events;
+}
+
+QList<QByteArray> UQQCodecBench::makePolls(const QList<QByteArray> &events, int messages, int perPoll) {
+    QList<QByteArray> polls;
+    int next = 0;
+
+    while (next < messages) {
+        QByteArray out("{\"retcode\":0,\"result\":[");
+        for (int i = 0; i < perPoll && next < messages; i++, next++) {
+            if (i) out += ',';
+            out += events.at(next % events.size());
+        }
+        out += "]}";
+        polls.append(out);
+    }
+    return polls;
+}
+
+// what parsePoll and readPollMessage do with a reply
+qint64 UQQCodecBench::streamDecode(const QByteArray &data) {
+    qint64 sum = 0;
+    UQQJsonReader reader(data);
+    if (!reader.enterObject()) return 0;
+
+    while (reader.nextName()) {
+        if (!reader.nameIs("result") || !reader.enterArray()) {
+            reader.skip();
+            continue;
+        }
+        while (reader.nextElement()) {
+            QByteArray value;
+            if (!reader.enterObject()) {
+                reader.skip();
+                continue;
+            }
+            while (reader.nextName()) {
+                if (reader.nameIs("value"))
+                    value = reader.readRaw();
+                else
+                    reader.skip();
+            }
+
+            UQQJsonReader v(value);
+            UQQMessage message;
+            if (!v.enterObject()) continue;
+            while (v.nextName()) {
+                if (v.nameIs("msg_id"))
+                    message.setId(int(v.readInt()));
+                else if (v.nameIs("from_uin"))
+                    message.setSrc(v.readUInt());
+                else if (v.nameIs("time"))
+                    message.setTimestamp(quint32(v.readUInt()));
+                else if (v.nameIs("content"))
+                    UQQContentCodec::decode(v.readRaw(), &message);
+                else
+                    v.skip();
+            }
+            sum += message.src() + message.segments().size();
+        }
+    }
+    return sum;
+}
+
+qint64 UQQCodecBench::variantDecode(const QByteArray &data) {
+    qint64 sum = 0;
+    QVariantMap m = QJsonDocument::fromJson(data).toVariant().toMap();
+
+    foreach (const QVariant &event, m.value("result").toList()) {
+        QVariantMap value = event.toMap().value("value").toMap();
+        QString text;
+        int segments = 0;
+
+        foreach (const QVariant &item, value.value("content").toList()) {
+            if (item.type() == QVariant::String) {
+                text.append(item.toString());
+                segments++;
+            } else {
+                QVariantList list = item.toList();
+                if (list.value(0).toString() == "face") {
+                    text.append(QString("[face%1]").arg(list.value(1).toInt()));
+                    segments++;
+                }
+            }
+        }
+        sum += value.value("from_uin").toULongLong() + segments;
+    }
+    return sum;
+}
+
+/*
+ * Each decoder runs over all polls rounds times, the best round counts.
+ * The checksums sum the uins and segments seen, so neither decoder can
+ * drop events unnoticed.
+ */
+QVariantMap UQQCodecBench::decode(const QString &fixtures, int messages, int perPoll, int rounds) {
+    QVariantMap result;
+    QList<QByteArray> events = fixtureEvents(fixtures);
+    if (events.isEmpty()) {
+        result.insert("error", QString("no poll fixtures in %1").arg(fixtures));
+        return result;
+    }
+    QList<QByteArray> polls = makePolls(events, messages, qMax(1, perPoll));
+    qint64 bytes = 0;
+    foreach (const QByteArray &poll, polls)
+        bytes += poll.size();
+
+    qint64 best[2] = { -1, -1 };
+    qint64 sums[2] = { 0, 0 };
+    QElapsedTimer timer;
+    for (int round = 0; round < qMax(1, rounds); round++) {
+        for (int way = 0; way < 2; way++) {
+            qint64 sum = 0;
+            timer.start();
+            foreach (const QByteArray &poll, polls)
+                sum += way == 0 ? streamDecode(poll) : variantDecode(poll);
+            qint64 ns = timer.nsecsElapsed();
+            if (best[way] < 0 || ns < best[way])
+                best[way] = ns;
+            sums[way] = sum;
+        }
+    }
+
+    const char *const names[2] = { "reader", "variant" };
+    for (int way = 0; way < 2; way++) {
+        QVariantMap m;
+        m.insert("ms", best[way] / 1e6);
+        m.insert("messagesPerSecond", best[way] > 0 ? messages * 1e9 / best[way] : 0.0);
+        m.insert("mbPerSecond", best[way] > 0 ? bytes * 1e3 / best[way] : 0.0);
+        m.insert("checksum", sums[way]);
+        result.insert(names[way], m);
+    }
+    result.insert("messages", messages);
+    result.insert("polls", polls.size());
+    result.insert("bytes", bytes);
+    result.insert("speedup", best[0] > 0 ? double(best[1]) / best[0] : 0.0);
+    return result;
+}
+
+// chat text with faces, quotes and line breaks, about length characters
+QString UQQCodecBench::pastedText(int length, quint64 seed) {
+    static const char *const Words[] = {
+        "hello", "\xE4\xBD\xA0\xE5\xA5\xBD", "ok", "\"quoted\"", "C:\\Users",
+        "http://web.qq.com/", "\xE4\xBB\x8A\xE5\xA4\xA9\xE6\x99\x9A\xE4\xB8\x8A"
+    };
+    static const int WordCount = sizeof(Words) / sizeof(Words[0]);
+
+    UQQRandom random(seed);
+    QString text;
+    text.reserve(length + 16);
+    while (text.size() < length) {
+        switch (random.bounded(8)) {
+        case 0:
+            text.append(QString("[face%1]").arg(random.bounded(135)));
+            break;
+        case 1:
+            text.append(QLatin1Char('\n'));
+            break;
+        default:
+            text.append(QString::fromUtf8(Words[random.bounded(WordCount)])).append(QLatin1Char(' '));
+        }
+    }
+    return text;
+}
+
+// the same content the straightforward way, faces split out with a QRegExp
+QString UQQCodecBench::arrayEncode(const QString &text) {
+    static const QRegExp face("\\[face(\\d{1,3})\\]");
+    QJsonArray content;
+    int from = 0;
+    int at;
+
+    while ((at = face.indexIn(text, from)) >= 0) {
+        if (at > from)
+            content.append(text.mid(from, at - from));
+        QJsonArray f;
+        f.append(QString("face"));
+        f.append(face.cap(1).toInt());
+        content.append(f);
+        from = at + face.matchedLength();
+    }
+    if (from < text.size())
+        content.append(text.mid(from));
+
+    QJsonArray style;
+    style.append(0);
+    style.append(0);
+    style.append(0);
+    QJsonObject font;
+    font.insert("name", QString("Arial"));
+    font.insert("size", QString("10"));
+    font.insert("style", style);
+    font.insert("color", QString("000000"));
+    QJsonArray fontEntry;
+    fontEntry.append(QString("font"));
+    fontEntry.append(font);
+    content.append(fontEntry);
+    return QString::fromUtf8(QJsonDocument(content).toJson(QJsonDocument::Compact));
+}
+
+QVariantMap UQQCodecBench::encode(int length, int count, int rounds) {
+    QList<QString> texts;
+    qint64 chars = 0;
+    for (int i = 0; i < qMax(1, count); i++) {
+        texts.append(pastedText(length, i + 1));
+        chars += texts.last().size();
+    }
+
+    UQQContentCodec codec;
+    qint64 best[2] = { -1, -1 };
+    qint64 sums[2] = { 0, 0 };
+    QElapsedTimer timer;
+    for (int round = 0; round < qMax(1, rounds); round++) {
+        for (int way = 0; way < 2; way++) {
+            qint64 sum = 0;
+            timer.start();
+            foreach (const QString &text, texts)
+                sum += way == 0 ? codec.encode(text).size() : arrayEncode(text).size();
+            qint64 ns = timer.nsecsElapsed();
+            if (best[way] < 0 || ns < best[way])
+                best[way] = ns;
+            sums[way] = sum;
+        }
+    }
+
+    QVariantMap result;
+    const char *const names[2] = { "codec", "jsonArray" };
+    for (int way = 0; way < 2; way++) {
+        QVariantMap m;
+        m.insert("ms", best[way] / 1e6);
+        m.insert("nsPerMessage", double(best[way]) / texts.size());
+        m.insert("mcharsPerSecond", best[way] > 0 ? chars * 1e3 / best[way] : 0.0);
+        m.insert("outputChars", sums[way]);
+        result.insert(names[way], m);
+    }
+    result.insert("messages", texts.size());
+    result.insert("length", length);
+    result.insert("speedup", best[0] > 0 ? double(best[1]) / best[0] : 0.0);
+    return result;
+}
@@ -0,0 +1,34 @@
+#ifndef UQQCODECBENCH_H
+#define UQQCODECBENCH_H
+
+#include <QVariantMap>
+#include <QStringList>
+#include <QByteArray>
+
+/*
+ * Micro-benchmarks of the protocol codecs, without a client or a network.
+ *
+ * decode() builds poll2 replies out of the events in the test/ fixtures,
+ * scaled to the given number of messages, and decodes them once with
+ * UQQJsonReader and UQQContentCodec, as UQQClient::parsePoll does, and
+ * once with QJsonDocument and QVariantMap, as the client used to.
+ *
+ * encode() times UQQContentCodec::encode() on pasted texts of the given
+ * length against a content array built with QJsonArray.
+ */
+class UQQCodecBench
+{
+public:
+    static QVariantMap decode(const QString &fixtures, int messages, int perPoll, int rounds);
+    static QVariantMap encode(int length, int count, int rounds);
+
+private:
+    static QList<QByteArray> fixtureEvents(const QString &fixtures);
+    static QList<QByteArray> makePolls(const QList<QByteArray> &events, int messages, int perPoll);
+    static qint64 streamDecode(const QByteArray &data);
+    static qint64 variantDecode(const QByteArray &data);
+    static QString pastedText(int length, quint64 seed);
+    static QString arrayEncode(const QString &text);
+};
+
+#endif // UQQCODECBENCH_H
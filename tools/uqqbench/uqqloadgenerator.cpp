@@ -0,0 +1,274 @@
+#include "uqqloadgenerator.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+static const char *const Texts[] = {
+    "hello",
+    "\\u4F60\\u597D",     // 你好
+    "\\u4ECA\\u5929\\u665A\\u4E0A\\u5403\\u4EC0\\u4E48\\uFF1F",
+    "ok, see you tomorrow",
+    "\\u54C8\\u54C8\\u54C8 lol",
+    "http://web.qq.com/ \\u3010\\u63D0\\u793A\\u3011"
+};
+static const int TextCount = sizeof(Texts) / sizeof(Texts[0]);
+
+static const char *const Statuses[] = { "online", "away", "busy", "silent", "offline" };
+static const int StatusCount = sizeof(Statuses) / sizeof(Statuses[0]);
+
+// the account of test/loginSuccess.txt
+static const char SelfUin[] = "121830387";
+
+static const quint64 BaseUin = 100000000;
+static const quint64 BaseGid = 1000000000;
+
+UQQLoadGenerator::Params::Params()
+    : buddies(200), groups(500), members(100), messages(100000),
+      churn(10), eventsPerPoll(20), seed(1) {
+}
+
+UQQLoadGenerator::Params::Params(const QVariantMap &map) {
+    Params d;
+    buddies = map.value("buddies", d.buddies).toInt();
+    groups = map.value("groups", d.groups).toInt();
+    members = map.value("members", d.members).toInt();
+    messages = map.value("messages", d.messages).toInt();
+    churn = map.value("churn", d.churn).toInt();
+    eventsPerPoll = qMax(1, map.value("eventsPerPoll", d.eventsPerPoll).toInt());
+    seed = map.value("seed", d.seed).toULongLong();
+}
+
+UQQLoadGenerator::UQQLoadGenerator(const Params &params)
+    : m_params(params), m_random(params.seed) {
+    m_messagesLeft = params.messages;
+    m_changesLeft = params.buddies > 0 ? qint64(params.messages) * params.churn / 100 : 0;
+    m_msgId = 1;
+    m_written = 0;
+}
+
+const UQQLoadGenerator::Params &UQQLoadGenerator::params() const {
+    return m_params;
+}
+
+quint64 UQQLoadGenerator::gid(int index) const {
+    return BaseGid + index * 2;
+}
+
+quint64 UQQLoadGenerator::code(int index) const {
+    return BaseGid + index * 2 + 1;
+}
+
+quint64 UQQLoadGenerator::buddyUin(int index) const {
+    return BaseUin + index;
+}
+
+// members overlap between neighbouring groups, as in real accounts
+quint64 UQQLoadGenerator::memberUin(int group, int index) const {
+    return BaseUin + m_params.buddies + quint64(group) * (m_params.members / 2) + index;
+}
+
+void UQQLoadGenerator::appendName(QByteArray &out, const char *prefix, int index) {
+    out += '"';
+    out += prefix;
+    out += QByteArray::number(index);
+    if (index % 3 == 0)
+        out += "\\u5C0F\\u660E";   // 小明
+    out += '"';
+}
+
+QByteArray UQQLoadGenerator::contact() {
+    QByteArray out;
+    out.reserve(m_params.buddies * 120 + 256);
+    out += "{\"retcode\":0,\"result\":{\"categories\":[],\"marknames\":[],\"vipinfo\":[],\"friends\":[";
+    for (int i = 0; i < m_params.buddies; i++) {
+        if (i) out += ',';
+        out += "{\"flag\":0,\"uin\":" + QByteArray::number(buddyUin(i)) + ",\"categories\":0}";
+    }
+    out += "],\"info\":[";
+    for (int i = 0; i < m_params.buddies; i++) {
+        if (i) out += ',';
+        out += "{\"face\":0,\"flag\":0,\"nick\":";
+        appendName(out, "buddy", i);
+        out += ",\"uin\":" + QByteArray::number(buddyUin(i)) + '}';
+    }
+    out += "]}}";
+    return out;
+}
+
+QByteArray UQQLoadGenerator::groupList() {
+    QByteArray out;
+    out.reserve(m_params.groups * 80 + 64);
+    out += "{\"retcode\":0,\"result\":{\"gmasklist\":[],\"gnamelist\":[";
+    for (int i = 0; i < m_params.groups; i++) {
+        if (i) out += ',';
+        out += "{\"flag\":1,\"name\":";
+        appendName(out, "group", i);
+        out += ",\"gid\":" + QByteArray::number(gid(i));
+        out += ",\"code\":" + QByteArray::number(code(i)) + '}';
+    }
+    out += "],\"gmarklist\":[]}}";
+    return out;
+}
+
+QByteArray UQQLoadGenerator::groupInfo(int index) {
+    const int n = m_params.members;
+    QByteArray out;
+    out.reserve(n * 200 + 512);
+
+    out += "{\"retcode\":0,\"result\":{\"stats\":[";
+    for (int i = 0; i < n; i += 4) {     // a quarter of them online
+        if (i) out += ',';
+        out += "{\"client_type\":1,\"uin\":" + QByteArray::number(memberUin(index, i)) + ",\"stat\":10}";
+    }
+    out += "],\"minfo\":[";
+    for (int i = 0; i < n; i++) {
+        if (i) out += ',';
+        out += "{\"nick\":";
+        appendName(out, "member", i);
+        out += ",\"province\":\"\",\"gender\":\"male\",\"uin\":" + QByteArray::number(memberUin(index, i));
+        out += ",\"country\":\"\",\"city\":\"\"}";
+    }
+    out += "],\"ginfo\":{\"face\":0,\"memo\":\"\",\"class\":10012,\"fingermemo\":\"\"";
+    out += ",\"code\":" + QByteArray::number(code(index));
+    out += ",\"createtime\":1112590413,\"flag\":1,\"level\":1,\"name\":";
+    appendName(out, "group", index);
+    out += ",\"gid\":" + QByteArray::number(gid(index));
+    out += ",\"owner\":" + QByteArray::number(memberUin(index, 0)) + ",\"members\":[";
+    for (int i = 0; i < n; i++) {
+        if (i) out += ',';
+        out += "{\"muin\":" + QByteArray::number(memberUin(index, i)) + ",\"mflag\":0}";
+    }
+    out += "],\"option\":2},\"cards\":[";
+    for (int i = 0; i < n; i += 5) {
+        if (i) out += ',';
+        out += "{\"muin\":" + QByteArray::number(memberUin(index, i)) + ",\"card\":";
+        appendName(out, "card", i);
+        out += '}';
+    }
+    out += "],\"vipinfo\":[]}}";
+    return out;
+}
+
+void UQQLoadGenerator::appendGroupMessage(QByteArray &out) {
+    int group = m_random.bounded(qMax(1, m_params.groups));
+    quint64 sender = memberUin(group, m_random.bounded(qMax(1, m_params.members)));
+
+    out += "{\"poll_type\":\"group_message\",\"value\":{\"msg_id\":" + QByteArray::number(m_msgId);
+    out += ",\"from_uin\":" + QByteArray::number(gid(group));
+    out += ",\"to_uin\":" + QByteArray::number(BaseUin - 1);
+    out += ",\"msg_id2\":" + QByteArray::number(m_msgId + 500000);
+    out += ",\"msg_type\":43,\"reply_ip\":176752216";
+    out += ",\"group_code\":" + QByteArray::number(code(group));
+    out += ",\"send_uin\":" + QByteArray::number(sender);
+    out += ",\"seq\":" + QByteArray::number(m_msgId) + ",\"time\":1366033221,\"info_seq\":15639045";
+    out += ",\"content\":[[\"font\",{\"size\":10,\"color\":\"000000\",\"style\":[0,0,0],\"name\":\"Arial\"}],\"";
+    out += Texts[m_random.bounded(TextCount)];
+    out += '"';
+    if (m_random.bounded(4) == 0)
+        out += ",[\"face\"," + QByteArray::number(m_random.bounded(105)) + "],\" \"";
+    out += "]}}";
+    m_msgId++;
+}
+
+void UQQLoadGenerator::appendStatusChange(QByteArray &out) {
+    out += "{\"poll_type\":\"buddies_status_change\",\"value\":{\"uin\":";
+    out += QByteArray::number(buddyUin(m_random.bounded(m_params.buddies)));
+    out += ",\"status\":\"";
+    out += Statuses[m_random.bounded(StatusCount)];
+    out += "\",\"client_type\":1}}";
+}
+
+/*
+ * Status changes are spread over the messages at the churn rate, each
+ * reply carries up to eventsPerPoll events.
+ */
+QByteArray UQQLoadGenerator::nextPoll(int *events) {
+    if (m_messagesLeft + m_changesLeft == 0)
+        return QByteArray();
+
+    QByteArray out;
+    out.reserve(m_params.eventsPerPoll * 420 + 32);
+    out += "{\"retcode\":0,\"result\":[";
+    int i = 0;
+    for (; i < m_params.eventsPerPoll && m_messagesLeft + m_changesLeft > 0; i++) {
+        if (i) out += ',';
+        if (m_random.bounded(m_messagesLeft + m_changesLeft) < m_changesLeft) {
+            appendStatusChange(out);
+            m_changesLeft--;
+        } else {
+            appendGroupMessage(out);
+            m_messagesLeft--;
+        }
+    }
+    out += "]}";
+    if (events)
+        *events = i;
+    return out;
+}
+
+bool UQQLoadGenerator::writeEntry(const QString &path, const QByteArray &data,
+                                  const QString &query, int events, const QString &cookie) {
+    QString name = QString("%1.txt").arg(++m_written, 6, 10, QChar('0'));
+    QFile body(m_dir.filePath(name));
+    if (!body.open(QIODevice::WriteOnly) || body.write(data) != data.size())
+        return false;
+
+    QJsonObject obj;
+    obj.insert("path", path);
+    obj.insert("file", name);
+    obj.insert("status", 200);
+    obj.insert("latency", 0.0);
+    QJsonArray cookies;
+    if (!cookie.isEmpty())
+        cookies.append(cookie);
+    obj.insert("cookies", cookies);
+    if (!query.isEmpty())
+        obj.insert("query", query);
+    if (events > 0)
+        obj.insert("events", events);
+
+    m_manifest.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    return m_manifest.write("\n") == 1;
+}
+
+/*
+ * The replies of a whole session in the order the client asks for them:
+ * check code and login of the account in test/, its nick and info, the
+ * friend list, no buddy online, the group list, the info of every group
+ * and then the polls. Faces and everything else are left out, the replay
+ * fails those requests.
+ */
+bool UQQLoadGenerator::writeRecording(const QString &dir) {
+    m_dir = QDir(dir);
+    if (!m_dir.mkpath(".")) return false;
+    m_manifest.setFileName(m_dir.filePath("manifest.json"));
+    if (!m_manifest.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    m_written = 0;
+
+    QString self = QString("tuin=%1").arg(SelfUin);
+    bool ok = writeEntry("/check", "ptui_checkVC('0','!IGQ','\\x00\\x00\\x00\\x00\\x07\\x42\\xfb\\xf3');")
+        && writeEntry("/login", "ptuiCB('0','0','http://web.qq.com/loginproxy.html','0','login ok', 'uqq');",
+                      QString(), 0, "ptwebqq=8ed6c8ea3ecd8001abe1df5bd166c5946b18ea79; Domain=qq.com; Path=/")
+        && writeEntry("/channel/login2", QByteArray("{\"retcode\":0,\"result\":{\"uin\":") + SelfUin
+                      + ",\"cip\":1918154156,\"index\":1075,\"port\":33413,\"status\":\"online\""
+                        ",\"vfwebqq\":\"8ed6c8ea3ecd8001abe1df5bd166c594\",\"psessionid\":\"8368046764001d636f6e6e\""
+                        ",\"user_state\":0,\"f\":0}}")
+        && writeEntry("/api/get_single_long_nick2", QByteArray("{\"retcode\":0,\"result\":[{\"uin\":") + SelfUin
+                      + ",\"lnick\":\"uqq\"}]}", self)
+        && writeEntry("/api/get_friend_info2", QByteArray("{\"retcode\":0,\"result\":{\"uin\":") + SelfUin
+                      + ",\"nick\":\"uqq\",\"gender\":\"male\",\"country\":\"\",\"province\":\"\",\"city\":\"\"}}", self)
+        && writeEntry("/api/get_user_friends2", contact())
+        && writeEntry("/channel/get_online_buddies2", "{\"retcode\":0,\"result\":[]}")
+        && writeEntry("/api/get_group_name_list_mask2", groupList());
+
+    for (int i = 0; ok && i < m_params.groups; i++)
+        ok = writeEntry("/api/get_group_info_ext2", groupInfo(i), QString("gcode=%1").arg(code(i)));
+
+    QByteArray data;
+    int events;
+    while (ok && !(data = nextPoll(&events)).isEmpty())
+        ok = writeEntry("/channel/poll2", data, QString(), events);
+
+    m_manifest.close();
+    return ok;
+}
@@ -0,0 +1,73 @@
+#ifndef UQQLOADGENERATOR_H
+#define UQQLOADGENERATOR_H
+
+#include <QByteArray>
+#include <QVariantMap>
+#include <QDir>
+#include <QFile>
+#include "uqqrandom.h"
+
+/*
+ * Synthesizes server replies at a given scale: a friend list
+ * (get_user_friends2), a group list (get_group_name_list_mask2), the info
+ * of every group (get_group_info_ext2) and a stream of poll2 replies
+ * carrying group messages and buddy status changes.
+ *
+ * The payloads have the shape of the ones in test/, names and message
+ * texts mix Chinese and ASCII and some messages carry faces. The same seed
+ * gives the same payloads, so two runs can be compared.
+ *
+ * writeRecording() stores them, with the login replies, as a recording
+ * UQQNetworkManager can replay (see uqqbench replay).
+ */
+class UQQLoadGenerator
+{
+public:
+    struct Params {
+        Params();
+        explicit Params(const QVariantMap &map);
+
+        int buddies;
+        int groups;
+        int members;        // per group
+        int messages;       // group messages in total
+        int churn;          // status changes per 100 messages
+        int eventsPerPoll;
+        quint64 seed;
+    };
+
+    explicit UQQLoadGenerator(const Params &params);
+
+    const Params &params() const;
+
+    QByteArray contact();
+    QByteArray groupList();
+    QByteArray groupInfo(int index);
+    quint64 gid(int index) const;
+    QByteArray nextPoll(int *events = 0);   // empty when all events are out
+
+    bool writeRecording(const QString &dir);
+
+private:
+    quint64 code(int index) const;
+    quint64 buddyUin(int index) const;
+    quint64 memberUin(int group, int index) const;
+    void appendName(QByteArray &out, const char *prefix, int index);
+    void appendGroupMessage(QByteArray &out);
+    void appendStatusChange(QByteArray &out);
+    bool writeEntry(const QString &path, const QByteArray &data,
+                    const QString &query = QString(), int events = 0,
+                    const QString &cookie = QString());
+
+    Params m_params;
+    UQQRandom m_random;
+    int m_messagesLeft;
+    int m_changesLeft;
+    int m_msgId;
+
+    QDir m_dir;
+    QFile m_manifest;
+    int m_written;
+};
+
+#endif // UQQLOADGENERATOR_H
@@ -0,0 +1,180 @@
+#include "uqqreplaybench.h"
+#include "uqqclient.h"
+#include "uqqcategorymodel.h"
+#include <QFile>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+static qint64 peakResidentKB() {
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly)) return -1;
+    foreach (const QByteArray &line, file.readAll().split('\n')) {
+        if (line.startsWith("VmHWM:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+    }
+    return -1;
+}
+
+UQQReplayBench::UQQReplayBench(QObject *parent)
+    : QObject(parent) {
+    m_client = Q_NULLPTR;
+    m_groupsRequested = false;
+    m_done = false;
+    m_events = 0;
+    m_loginAt = m_readyAt = m_groupsAt = m_pollStartAt = -1;
+
+    m_pollTimer = new QTimer(this);
+    m_pollTimer->setInterval(10);
+    connect(m_pollTimer, SIGNAL(timeout()), this, SLOT(checkPolls()));
+
+    m_timeoutTimer = new QTimer(this);
+    m_timeoutTimer->setSingleShot(true);
+    connect(m_timeoutTimer, SIGNAL(timeout()), this, SLOT(onTimeout()));
+}
+
+bool UQQReplayBench::start(const QString &dir, double speed, const QString &uin, int timeout) {
+    if (!QFile::exists(QDir(dir).filePath("manifest.json"))) {
+        qWarning("uqqbench: %s has no manifest.json", qPrintable(dir));
+        return false;
+    }
+    if (!m_home.isValid()) return false;
+
+    // read by the client and its UQQNetworkManager when they are created
+    qputenv("HOME", QFile::encodeName(m_home.path()));
+    qputenv("UQQ_TRANSPORT", "replay");
+    qputenv("UQQ_TRANSPORT_DIR", QFile::encodeName(dir));
+    qputenv("UQQ_REPLAY_SPEED", QByteArray::number(speed));
+    qputenv("UQQ_ENDPOINT", "");    // recorded cookies belong to the qq.com hosts
+
+    m_uin = uin;
+    m_events = recordedEvents(dir);
+    m_client = new UQQClient(this);
+    connect(m_client, SIGNAL(captchaChanged(bool)), this, SLOT(onCaptchaChanged(bool)));
+    connect(m_client, SIGNAL(errorChanged(int)), this, SLOT(onErrorChanged(int)));
+    connect(m_client, SIGNAL(groupListReady()), this, SLOT(onGroupListReady()));
+    connect(m_client, SIGNAL(groupReady(quint64)), this, SLOT(onGroupReady(quint64)));
+    connect(m_client, SIGNAL(ready()), this, SLOT(onReady()));
+
+    if (timeout > 0)
+        m_timeoutTimer->start(timeout * 1000);
+    m_clock.start();
+    m_client->checkCode(uin);
+    return true;
+}
+
+// the events of the recorded polls, the generator notes them in the manifest
+int UQQReplayBench::recordedEvents(const QString &dir) {
+    QFile file(QDir(dir).filePath("manifest.json"));
+    if (!file.open(QIODevice::ReadOnly)) return 0;
+
+    int events = 0;
+    while (!file.atEnd()) {
+        QJsonObject obj = QJsonDocument::fromJson(file.readLine()).object();
+        if (obj.value("path").toString() == "/channel/poll2")
+            events += obj.contains("events") ? int(obj.value("events").toDouble()) : 1;
+    }
+    return events;
+}
+
+void UQQReplayBench::onCaptchaChanged(bool needed) {
+    if (needed) {
+        finish(false, "the recording asks for a captcha");
+        return;
+    }
+    m_loginAt = m_clock.elapsed();
+    // the password is not checked by a replay
+    m_client->login(m_uin, QString(32, QLatin1Char('0')),
+                    m_client->getLoginInfo("vc").toString(), "online");
+}
+
+void UQQReplayBench::onErrorChanged(int errCode) {
+    if (errCode != UQQClient::NoError)
+        finish(false, QString("login failed, error %1").arg(errCode));
+}
+
+// like the group page does when a group is opened, only for all of them
+void UQQReplayBench::onGroupListReady() {
+    if (m_groupsRequested) return;
+    m_groupsRequested = true;
+
+    UQQCategoryModel *model = qobject_cast<UQQCategoryModel *>(m_client->getGroupList());
+    if (!model) return;
+
+    QList<quint64> gids;
+    for (int row = 0; row < model->rowCount(); row++) {
+        UQQCategory *group = qobject_cast<UQQCategory *>(model->get(row));
+        if (group) gids.append(group->id());
+    }
+    foreach (quint64 gid, gids)
+        m_pendingGroups.insert(gid);
+    foreach (quint64 gid, gids)
+        m_client->loadGroupInfo(gid);
+    if (m_pendingGroups.isEmpty())
+        m_groupsAt = m_clock.elapsed();
+}
+
+void UQQReplayBench::onGroupReady(quint64 gid) {
+    if (m_pendingGroups.remove(gid) && m_pendingGroups.isEmpty())
+        m_groupsAt = m_clock.elapsed();
+}
+
+void UQQReplayBench::onReady() {
+    if (m_readyAt >= 0) return;
+    m_readyAt = m_clock.elapsed();
+    m_pollStartAt = m_readyAt;
+    m_client->poll();
+    m_pollTimer->start();
+}
+
+/*
+ * The recording is used up when a poll fails, the replay answers a poll
+ * it has no entry for with an error.
+ */
+void UQQReplayBench::checkPolls() {
+    QVariantMap poll = m_client->pollMetrics();
+    if (poll.value("errors").toInt() > 0 && m_pendingGroups.isEmpty())
+        finish(true, QString());
+}
+
+void UQQReplayBench::onTimeout() {
+    finish(false, "timed out");
+}
+
+void UQQReplayBench::finish(bool ok, const QString &reason) {
+    if (m_done) return;
+    m_done = true;
+
+    qint64 now = m_clock.elapsed();
+    m_pollTimer->stop();
+    m_timeoutTimer->stop();
+    if (m_client)
+        m_client->stopPoll();
+
+    QVariantMap phases;
+    phases.insert("loginMs", m_loginAt);
+    phases.insert("readyMs", m_readyAt);
+    phases.insert("groupInfoMs", m_groupsAt);
+    phases.insert("totalMs", now);
+
+    QVariantMap metrics = m_client ? m_client->metrics() : QVariantMap();
+    QVariantMap poll = metrics.value("poll").toMap();
+    int polls = poll.value("polls").toInt();
+    qint64 pollTime = m_pollStartAt >= 0 ? now - m_pollStartAt : 0;
+
+    m_result.insert("ok", ok);
+    if (!reason.isEmpty())
+        m_result.insert("error", reason);
+    m_result.insert("phases", phases);
+    m_result.insert("polls", polls);
+    m_result.insert("events", m_events);
+    m_result.insert("eventsPerSecond", pollTime > 0 ? m_events * 1000.0 / pollTime : 0.0);
+    m_result.insert("peakRssKB", peakResidentKB());
+    m_result.insert("metrics", metrics);
+
+    emit finished(ok);
+}
+
+QVariantMap UQQReplayBench::result() const {
+    return m_result;
+}
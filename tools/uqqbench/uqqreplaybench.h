@@ -0,0 +1,68 @@
+#ifndef UQQREPLAYBENCH_H
+#define UQQREPLAYBENCH_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QSet>
+#include <QTimer>
+#include <QVariantMap>
+
+class UQQClient;
+
+/*
+ * Drives a UQQClient through a recorded session, served by
+ * UQQNetworkManager in replay mode: check code, login, contact list,
+ * online buddies, group list, the info of every group and then polls
+ * until the recording has no poll left. Reports the time of each phase,
+ * the poll throughput, the per action latencies of UQQClient::metrics()
+ * and the peak RSS.
+ *
+ * The client runs with a temporary HOME, snapshots and history of the
+ * replayed account never mix with a real one.
+ */
+class UQQReplayBench : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UQQReplayBench(QObject *parent = 0);
+
+    // false if the recording can not be replayed
+    bool start(const QString &dir, double speed, const QString &uin, int timeout);
+    QVariantMap result() const;
+
+signals:
+    void finished(bool ok);
+
+private slots:
+    void onCaptchaChanged(bool needed);
+    void onErrorChanged(int errCode);
+    void onGroupListReady();
+    void onGroupReady(quint64 gid);
+    void onReady();
+    void checkPolls();
+    void onTimeout();
+
+private:
+    void finish(bool ok, const QString &reason);
+    static int recordedEvents(const QString &dir);
+
+    UQQClient *m_client;
+    QTemporaryDir m_home;
+    QString m_uin;
+    QElapsedTimer m_clock;
+    QTimer *m_pollTimer;
+    QTimer *m_timeoutTimer;
+    QSet<quint64> m_pendingGroups;
+    bool m_groupsRequested;
+    bool m_done;
+    int m_events;
+
+    qint64 m_loginAt;
+    qint64 m_readyAt;
+    qint64 m_groupsAt;
+    qint64 m_pollStartAt;
+    QVariantMap m_result;
+};
+
+#endif // UQQREPLAYBENCH_H
@@ -0,0 +1,9 @@
+# The QML plugin, the benchmark tool and the tests, uqq.sh builds the plugin alone.
+
+TEMPLATE = subdirs
+
+SUBDIRS += plugin \
+    tools/uqqbench \
+    tests
+
+plugin.file = plugin/uqqplugin.pro
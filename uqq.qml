@@ -27,7 +27,7 @@ Item {
     Connections {
         target: QQ.Client
         onLoginSuccess: QQ.Client.loadContact();
-        onReady: loader.source = "components/MainPage.qml";
+        onContactReady: loader.source = "components/MainPage.qml";
         onKicked: {
             loader.source = "";
             main.msg = reason;